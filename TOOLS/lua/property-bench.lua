@@ -0,0 +1,42 @@
+-- Measure how many property getter calls per second scripts can make.
+-- Load a file (playback can be paused), then press "b" to run the benchmark:
+--
+--   mpv --script=TOOLS/lua/property-bench.lua --pause file.mkv
+--
+-- Results are printed to the terminal.
+
+local DURATION = 0.5 -- seconds per test
+
+local tests = {
+    {"get_property_number", "time-pos"},
+    {"get_property_bool", "pause"},
+    {"get_property", "media-title"},
+    {"get_property_osd", "time-pos"},
+    {"get_property_native", "time-pos"},
+    {"get_property_native", "pause"},
+    {"get_property_native", "video-params"},
+    {"get_property_native", "track-list"},
+    {"get_property_native", "chapter-list"},
+}
+
+local function run(fn, name)
+    local count = 0
+    local start = mp.get_time()
+    local elapsed = 0
+    while elapsed < DURATION do
+        for _ = 1, 100 do
+            fn(name)
+        end
+        count = count + 100
+        elapsed = mp.get_time() - start
+    end
+    return count / elapsed
+end
+
+mp.add_key_binding("b", "property-bench", function()
+    for _, test in ipairs(tests) do
+        local fn_name, prop = test[1], test[2]
+        local rate = run(mp[fn_name], prop)
+        print(string.format("%-20s %-15s %10.0f calls/s", fn_name, prop, rate))
+    end
+end)
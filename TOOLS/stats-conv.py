@@ -1,9 +1,12 @@
 #!/usr/bin/env python3
-from pyqtgraph.Qt import QtGui, QtCore
-import pyqtgraph as pg
+import struct
 import sys
 import re
 
+to_text = len(sys.argv) > 1 and sys.argv[1] == "--to-text"
+if to_text:
+    sys.argv.pop(1)
+
 filename = sys.argv[1]
 
 events = ".*"
@@ -34,8 +37,82 @@ Currently, the following event types are supported:
     'range-timed' <ts1> <ts2> <name>        like start/end, but explicit times
     <name>                      singular event (same as 'signal')
 
+Files written with --dump-stats-format=binary are detected automatically.
+Use
+
+    stats-conv.py --to-text <filename>
+
+to print any stats file in the text format.
 """
 
+def read_binary(f):
+    """Yield (timestamp, text) tuples from a binary stats file."""
+    data = f.read()
+    pos = 0
+
+    def varint():
+        nonlocal pos
+        v = shift = 0
+        while True:
+            b = data[pos]
+            pos += 1
+            v |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                return v
+
+    def string():
+        nonlocal pos
+        l = varint()
+        pos += l
+        return data[pos - l:pos].decode("utf-8", "replace")
+
+    if data[8] != 1:
+        sys.exit("unsupported binary stats version %d" % data[8])
+    pos = 9
+    strings = []
+    ts = 0
+    while pos < len(data):
+        rtype = data[pos]
+        pos += 1
+        if rtype == 1:      # string definition
+            varint()
+            strings.append(string())
+        elif rtype == 2:    # event
+            ts += varint()
+            yield ts, strings[varint()]
+        elif rtype == 3:    # value
+            ts += varint()
+            name = strings[varint()]
+            val, = struct.unpack_from("<d", data, pos)
+            pos += 8
+            yield ts, "value %f %s" % (val, name)
+        else:
+            sys.exit("invalid record type %d at offset %d" % (rtype, pos - 1))
+
+def read_text(f):
+    for line in f:
+        line = line.decode("utf-8", "replace").split("#")[0].strip()
+        if line:
+            ts, event = line.split(" ", 1)
+            yield int(ts), event
+
+def read_stats(filename):
+    f = open(filename, "rb")
+    if f.read(8) == b"mpvstats":
+        f.seek(0)
+        return read_binary(f)
+    f.seek(0)
+    return read_text(f)
+
+if to_text:
+    for ts, event in read_stats(filename):
+        print("%d %s" % (ts, event))
+    sys.exit(0)
+
+from pyqtgraph.Qt import QtGui, QtCore
+import pyqtgraph as pg
+
 class G:
     events = {}
     start = None
@@ -72,12 +149,8 @@ def mkColor(t):
 
 SCALE = 1e6 # microseconds to seconds
 
-for line in [line.split("#")[0].strip() for line in open(filename, "r")]:
-    line = line.strip()
-    if not line:
-        continue
-    ts, event = line.split(" ", 1)
-    ts = int(ts) / SCALE
+for ts, event in read_stats(filename):
+    ts = ts / SCALE
     if G.start is None:
         G.start = ts
     ts = ts - G.start
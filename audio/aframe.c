@@ -601,8 +601,7 @@ bool mp_aframe_set_silence(struct mp_aframe *f, int offset, int samples)
 bool mp_aframe_reverse(struct mp_aframe *f)
 {
     int format = mp_aframe_get_format(f);
-    size_t bps = af_fmt_to_bytes(format);
-    if (!af_fmt_is_pcm(format) || bps > 16)
+    if (!af_fmt_is_pcm(format))
         return false;
 
     uint8_t **d = mp_aframe_get_data_rw(f);
@@ -611,28 +610,10 @@ bool mp_aframe_reverse(struct mp_aframe *f)
 
     int planes = mp_aframe_get_planes(f);
     int samples = mp_aframe_get_size(f);
-    int channels = mp_aframe_get_channels(f);
     size_t sstride = mp_aframe_get_sstride(f);
 
-    int plane_samples = channels;
-    if (af_fmt_is_planar(format))
-        plane_samples = 1;
-
-    for (int p = 0; p < planes; p++) {
-        for (int n = 0; n < samples / 2; n++) {
-            int s1_offset = n * sstride;
-            int s2_offset = (samples - 1 - n) * sstride;
-            for (int c = 0; c < plane_samples; c++) {
-                // Nobody said it'd be fast.
-                char tmp[16];
-                uint8_t *s1 = d[p] + s1_offset + c * bps;
-                uint8_t *s2 = d[p] + s2_offset + c * bps;
-                memcpy(tmp, s2, bps);
-                memcpy(s2, s1, bps);
-                memcpy(s1, tmp, bps);
-            }
-        }
-    }
+    for (int p = 0; p < planes; p++)
+        af_reverse_samples(d[p], samples, sstride);
 
     return true;
 }
@@ -18,6 +18,8 @@
  */
 
 #include <limits.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "common/common.h"
 #include "format.h"
@@ -144,6 +146,48 @@ void af_fill_silence(void *dst, size_t bytes, int format)
     memset(dst, af_fmt_is_unsigned(format) ? 0x80 : 0, bytes);
 }
 
+// Swap the first and last sample, and so on. Each sample is swapped in units
+// of type, so stride must be a multiple of sizeof(type). Passing a constant
+// stride lets the compiler turn the inner loop into a single load/store.
+#define REVERSE_SAMPLES(type, stride)                                       \
+    for (uint8_t *lo = data, *hi = lo + (samples - 1) * (stride);           \
+         lo < hi; lo += (stride), hi -= (stride))                           \
+    {                                                                       \
+        for (size_t i = 0; i < (stride); i += sizeof(type)) {               \
+            type a, b;                                                      \
+            memcpy(&a, lo + i, sizeof(type));                               \
+            memcpy(&b, hi + i, sizeof(type));                               \
+            memcpy(lo + i, &b, sizeof(type));                               \
+            memcpy(hi + i, &a, sizeof(type));                               \
+        }                                                                   \
+    }
+
+// Reverse the order of the given number of samples in-place. sstride is the
+// size of a sample in bytes; for interleaved formats, this includes all
+// channels, whose order within a sample is preserved.
+void af_reverse_samples(void *data, int samples, size_t sstride)
+{
+    if (samples < 2)
+        return;
+
+    switch (sstride) {
+    case 1: REVERSE_SAMPLES(uint8_t,  1); return;
+    case 2: REVERSE_SAMPLES(uint16_t, 2); return;
+    case 4: REVERSE_SAMPLES(uint32_t, 4); return;
+    case 8: REVERSE_SAMPLES(uint64_t, 8); return;
+    }
+
+    if (sstride % 8 == 0) {
+        REVERSE_SAMPLES(uint64_t, sstride);
+    } else if (sstride % 4 == 0) {
+        REVERSE_SAMPLES(uint32_t, sstride);
+    } else if (sstride % 2 == 0) {
+        REVERSE_SAMPLES(uint16_t, sstride);
+    } else {
+        REVERSE_SAMPLES(uint8_t, sstride);
+    }
+}
+
 // Returns a "score" that serves as heuristic how lossy or hard a conversion is.
 // If the formats are equal, 1024 is returned. If they are gravely incompatible
 // (like s16<->ac3), INT_MIN is returned. If there is implied loss of precision
@@ -67,6 +67,7 @@ int af_fmt_to_planar(int format);
 int af_fmt_from_planar(int format);
 
 void af_fill_silence(void *dst, size_t bytes, int format);
+void af_reverse_samples(void *data, int samples, size_t sstride);
 
 void af_get_best_sample_formats(int src_format, int *out_formats);
 int af_format_conversion_score(int dst_format, int src_format);
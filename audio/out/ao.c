@@ -146,6 +146,8 @@ const struct m_sub_options ao_conf = {
         {"audio-client-name", OPT_STRING(audio_client_name), .flags = UPDATE_AUDIO},
         {"audio-buffer", OPT_DOUBLE(audio_buffer),
             .flags = UPDATE_AUDIO, M_RANGE(0, 10)},
+        {"audio-buffer-adaptive", OPT_FLAG(audio_buffer_adaptive),
+            .flags = UPDATE_AUDIO},
         {0}
     },
     .size = sizeof(OPT_BASE_STRUCT),
@@ -180,6 +182,7 @@ static struct ao *ao_alloc(bool probing, struct mpv_global *global,
         .wakeup_ctx = wakeup_ctx,
         .log = mp_log_new(ao, log, name),
         .def_buffer = opts->audio_buffer,
+        .adaptive_buffer = opts->audio_buffer_adaptive,
         .client_name = talloc_strdup(ao, opts->audio_client_name),
     };
     talloc_free(opts);
@@ -91,6 +91,7 @@ struct ao_opts {
     char *audio_device;
     char *audio_client_name;
     double audio_buffer;
+    int audio_buffer_adaptive;
 };
 
 struct ao *ao_init_best(struct mpv_global *global,
@@ -114,6 +115,16 @@ void ao_drain(struct ao *ao);
 bool ao_is_playing(struct ao *ao);
 struct mp_async_queue;
 struct mp_async_queue *ao_get_queue(struct ao *ao);
+void ao_set_prebuffer(struct ao *ao, double secs, int64_t max_bytes);
+void ao_report_underrun(struct ao *ao);
+
+struct ao_buffer_stats {
+    double latency;         // same as ao_get_delay()
+    double buffer_size;     // current soft-buffer size in seconds
+    int underruns;          // total number of underruns reported
+};
+
+void ao_get_buffer_stats(struct ao *ao, struct ao_buffer_stats *stats);
 int ao_query_and_reset_events(struct ao *ao, int events);
 int ao_add_events(struct ao *ao, int events);
 void ao_unblock(struct ao *ao);
@@ -37,6 +37,11 @@
 #include "osdep/timer.h"
 #include "osdep/threads.h"
 
+// --audio-buffer-adaptive: initial/minimum soft-buffer, and how long playback
+// must be free of underruns before the soft-buffer is halved again.
+#define AO_ADAPTIVE_MIN_MS 5
+#define AO_ADAPTIVE_STABLE_US (10 * 1000 * 1000)
+
 struct buffer_state {
     // Buffer and AO
     pthread_mutex_t lock;
@@ -66,6 +71,13 @@ struct buffer_state {
 
     bool initial_unblocked;
 
+    int soft_buffer;            // current queue size in samples (<= ao->buffer)
+    int min_soft_buffer;        // lower bound for --audio-buffer-adaptive
+    int64_t stable_since_us;    // time of last underrun or soft_buffer change
+    int underruns;              // number of ao_report_underrun() calls
+    int64_t prebuffer_samples;  // ao_set_prebuffer() (0 if disabled)
+    int64_t prebuffer_max_bytes;
+
     // "Push" AOs only (AOs with driver->write).
     bool hw_paused;             // driver->set_pause() was used successfully
     bool recover_pause;         // non-hw_paused: needs to recover delay
@@ -80,6 +92,7 @@ struct buffer_state {
 };
 
 static void *playthread(void *arg);
+static void update_adaptive_buffer(struct ao *ao);
 
 void ao_wakeup_playthread(struct ao *ao)
 {
@@ -142,10 +155,14 @@ static int read_buffer(struct ao *ao, void **data, int samples, bool *eof)
         int copy = mp_aframe_get_size(p->pending);
         uint8_t **fdata = mp_aframe_get_data_ro(p->pending);
         copy = MPMIN(copy, samples - pos);
+        void *dst[MP_NUM_CHANNELS];
         for (int n = 0; n < ao->num_planes; n++) {
-            memcpy((char *)data[n] + pos * ao->sstride,
-                   fdata[n], copy * ao->sstride);
+            dst[n] = (char *)data[n] + pos * ao->sstride;
+            memcpy(dst[n], fdata[n], copy * ao->sstride);
         }
+        // Apply the gain while the copied block is still in the cache, instead
+        // of making another pass over the whole buffer.
+        ao_post_process_data(ao, dst, copy);
         mp_aframe_skip_samples(p->pending, copy);
         pos += copy;
         *eof = false;
@@ -167,7 +184,6 @@ static int read_buffer(struct ao *ao, void **data, int samples, bool *eof)
                         ao->format);
     }
 
-    ao_post_process_data(ao, data, pos);
     return pos;
 }
 
@@ -188,8 +204,10 @@ int ao_read_data(struct ao *ao, void **data, int samples, int64_t out_time_us)
 
     int pos = read_buffer(ao, data, samples, &(bool){0});
 
-    if (pos > 0)
+    if (pos > 0) {
         p->end_time_us = out_time_us;
+        update_adaptive_buffer(ao);
+    }
 
     if (pos < samples && p->playing && !p->paused) {
         p->playing = false;
@@ -223,6 +241,14 @@ int ao_read_data_converted(struct ao *ao, struct ao_convert_fmt *fmt,
     int src_plane_size = plane_samples * af_fmt_to_bytes(fmt->src_fmt);
     int dst_plane_size = plane_samples * fmt->dst_bits / 8;
 
+    // If the samples don't change size, convert in the device buffer directly
+    // instead of going through convert_buffer.
+    if (src_plane_size == dst_plane_size) {
+        int res = ao_read_data(ao, data, samples, out_time_us);
+        ao_convert_inplace(fmt, data, samples);
+        return res;
+    }
+
     int needed = src_plane_size * planes;
     if (needed > talloc_get_size(p->convert_buffer) || !p->convert_buffer) {
         talloc_free(p->convert_buffer);
@@ -283,6 +309,96 @@ double ao_get_delay(struct ao *ao)
     return driver_delay + pending / (double)ao->samplerate;
 }
 
+// called locked
+static void update_queue_config(struct ao *ao)
+{
+    struct buffer_state *p = ao->buffer_state;
+
+    struct mp_async_queue_config cfg = {
+        .sample_unit = AQUEUE_UNIT_SAMPLES,
+        .max_samples = p->soft_buffer,
+        .max_bytes = INT64_MAX,
+    };
+    if (p->prebuffer_samples > p->soft_buffer) {
+        cfg.max_samples = p->prebuffer_samples;
+        cfg.max_bytes = MPMAX(p->prebuffer_max_bytes,
+                              (int64_t)p->soft_buffer * ao->sstride *
+                              ao->num_planes);
+    }
+    mp_async_queue_set_config(p->queue, cfg);
+}
+
+// Temporarily allow the queue to buffer up to secs of audio (but not more than
+// max_bytes), instead of the normal soft-buffer size. This is used to queue
+// the tail of a file before a gapless transition, so that the next file's
+// decoder and filter initialization does not make the AO underrun. Passing
+// secs=0 restores the normal size; already queued data is still played.
+void ao_set_prebuffer(struct ao *ao, double secs, int64_t max_bytes)
+{
+    struct buffer_state *p = ao->buffer_state;
+
+    if (secs > 0)
+        MP_VERBOSE(ao, "prebuffering up to %f seconds.\n", secs);
+
+    pthread_mutex_lock(&p->lock);
+    p->prebuffer_samples = MPMAX(secs * ao->samplerate, 0);
+    p->prebuffer_max_bytes = max_bytes;
+    update_queue_config(ao);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Called by the player when it detected that the AO ran out of data before
+// the end of the stream. With --audio-buffer-adaptive, this grows the queue.
+void ao_report_underrun(struct ao *ao)
+{
+    struct buffer_state *p = ao->buffer_state;
+
+    pthread_mutex_lock(&p->lock);
+    p->underruns++;
+    p->stable_since_us = mp_time_us();
+    if (ao->adaptive_buffer && p->soft_buffer < ao->buffer) {
+        p->soft_buffer = MPMIN(p->soft_buffer * 2, ao->buffer);
+        MP_VERBOSE(ao, "increasing soft-buffer to %d samples.\n",
+                   p->soft_buffer);
+        update_queue_config(ao);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+// With --audio-buffer-adaptive, shrink the queue again after a period without
+// underruns. Called locked, whenever data was successfully played.
+static void update_adaptive_buffer(struct ao *ao)
+{
+    struct buffer_state *p = ao->buffer_state;
+
+    if (!ao->adaptive_buffer || p->soft_buffer <= p->min_soft_buffer)
+        return;
+
+    int64_t now = mp_time_us();
+    if (now - p->stable_since_us < AO_ADAPTIVE_STABLE_US)
+        return;
+
+    p->soft_buffer = MPMAX(p->soft_buffer / 2, p->min_soft_buffer);
+    p->stable_since_us = now;
+    MP_VERBOSE(ao, "decreasing soft-buffer to %d samples.\n", p->soft_buffer);
+    update_queue_config(ao);
+}
+
+void ao_get_buffer_stats(struct ao *ao, struct ao_buffer_stats *stats)
+{
+    struct buffer_state *p = ao->buffer_state;
+
+    double delay = ao_get_delay(ao);
+
+    pthread_mutex_lock(&p->lock);
+    *stats = (struct ao_buffer_stats){
+        .latency = delay,
+        .buffer_size = p->soft_buffer / (double)ao->samplerate,
+        .underruns = p->underruns,
+    };
+    pthread_mutex_unlock(&p->lock);
+}
+
 // Fully stop playback; clear buffers, including queue.
 void ao_reset(struct ao *ao)
 {
@@ -516,12 +632,22 @@ bool init_buffer_post(struct ao *ao)
 
     mp_async_queue_resume_reading(p->queue);
 
-    struct mp_async_queue_config cfg = {
-        .sample_unit = AQUEUE_UNIT_SAMPLES,
-        .max_samples = ao->buffer,
-        .max_bytes = INT64_MAX,
-    };
-    mp_async_queue_set_config(p->queue, cfg);
+    p->soft_buffer = ao->buffer;
+    p->min_soft_buffer = ao->buffer;
+    if (ao->adaptive_buffer) {
+        int align = af_format_sample_alignment(ao->format);
+        int min = MPMAX(ao->samplerate / 1000 * AO_ADAPTIVE_MIN_MS, 1);
+        min = (min + align - 1) / align * align;
+        p->min_soft_buffer = MPMIN(min, ao->buffer);
+        p->soft_buffer = p->min_soft_buffer;
+        MP_VERBOSE(ao, "adaptive soft-buffer: %d-%d samples.\n",
+                   p->min_soft_buffer, ao->buffer);
+    }
+    p->stable_since_us = mp_time_us();
+
+    pthread_mutex_lock(&p->lock);
+    update_queue_config(ao);
+    pthread_mutex_unlock(&p->lock);
 
     if (ao->driver->write) {
         mp_filter_graph_set_wakeup_cb(p->filter_root, wakeup_filters, ao);
@@ -621,6 +747,8 @@ static bool ao_play_data(struct ao *ao)
             MP_ERR(ao, "Error writing audio to device.\n");
         MP_STATS(ao, "end ao fill");
 
+        update_adaptive_buffer(ao);
+
         if (!p->streaming) {
             MP_VERBOSE(ao, "starting AO\n");
             ao->driver->start(ao);
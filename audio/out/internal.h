@@ -67,6 +67,7 @@ struct ao {
 
     int buffer;
     double def_buffer;
+    bool adaptive_buffer;       // --audio-buffer-adaptive (buffer is the max.)
     struct buffer_state *buffer_state;
 };
 
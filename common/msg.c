@@ -31,6 +31,7 @@
 #include "common/common.h"
 #include "common/global.h"
 #include "misc/bstr.h"
+#include "misc/thread_tools.h"
 #include "options/options.h"
 #include "options/path.h"
 #include "osdep/terminal.h"
@@ -45,12 +46,24 @@
 
 #define TERM_BUF 100
 
+// Number of records in the log file queue.
+#define LOG_FILE_QUEUE 1024
+
+// A piece of a preformatted log file line. Lines longer than a record are
+// split into multiple records, which are queued back to back.
+struct log_file_record {
+    bool first;                 // start of a line
+    uint16_t len;               // number of valid bytes in text
+    char text[256];
+};
+
 struct mp_log_root {
     struct mpv_global *global;
     pthread_mutex_t lock;
     pthread_mutex_t log_file_lock;
     pthread_cond_t log_file_wakeup;
     // --- protected by lock
+    bool log_file_active;   // queue messages to log_file_queue
     char **msg_levels;
     bool use_terminal;  // make accesses to stderr/stdout
     bool module;
@@ -65,6 +78,12 @@ struct mp_log_root {
     int num_buffers;
     struct mp_log_buffer *early_buffer;
     FILE *stats_file;
+    bool stats_binary;      // stats_file uses the binary format
+    int64_t stats_last_time; // timestamp of the last binary record
+    char **stats_strings;   // interned strings of the binary format (by id)
+    int num_stats_strings;
+    int *stats_hash;        // hash table for stats_strings (id + 1, or 0)
+    int stats_hash_size;    // power of 2
     bstr buffer;
     // --- must be accessed atomically
     /* This is incremented every time the msglevels must be reloaded.
@@ -74,12 +93,16 @@ struct mp_log_root {
     // --- owner thread only (caller of mp_msg_init() etc.)
     char *log_path;
     char *stats_path;
+    int stats_format;
     pthread_t log_file_thread;
     // --- owner thread only, but frozen while log_file_thread is running
     FILE *log_file;
-    struct mp_log_buffer *log_file_buffer;
+    struct mp_mpsc_queue *log_file_queue; // of struct log_file_record
     // --- protected by log_file_lock
     bool log_file_thread_active; // also termination signal for the thread
+    // --- must be accessed atomically
+    atomic_bool log_file_waiting; // log_file_thread waits for new records
+    mp_atomic_uint64 log_file_dropped; // number of lost messages
 };
 
 struct mp_log {
@@ -135,12 +158,10 @@ static void update_loglevel(struct mp_log *log)
     log->terminal_level = log->level;
     for (int n = 0; n < log->root->num_buffers; n++) {
         int buffer_level = log->root->buffers[n]->level;
-        if (buffer_level == MP_LOG_BUFFER_MSGL_LOGFILE)
-            buffer_level = MSGL_DEBUG;
         if (buffer_level != MP_LOG_BUFFER_MSGL_TERM)
             log->level = MPMAX(log->level, buffer_level);
     }
-    if (log->root->log_file)
+    if (log->root->log_file_active)
         log->level = MPMAX(log->level, MSGL_DEBUG);
     if (log->root->stats_file)
         log->level = MPMAX(log->level, MSGL_STATS);
@@ -346,27 +367,7 @@ static void write_msg_to_buffers(struct mp_log *log, int lev, char *text)
         int buffer_level = buffer->level;
         if (buffer_level == MP_LOG_BUFFER_MSGL_TERM)
             buffer_level = log->terminal_level;
-        if (buffer_level == MP_LOG_BUFFER_MSGL_LOGFILE)
-            buffer_level = MPMAX(log->terminal_level, MSGL_DEBUG);
         if (lev <= buffer_level && lev != MSGL_STATUS) {
-            if (buffer->level == MP_LOG_BUFFER_MSGL_LOGFILE) {
-                // If the buffer is full, block until we can write again.
-                bool dead = false;
-                while (buffer->num_entries == buffer->capacity && !dead) {
-                    // Temporary unlock is OK; buffer->level is immutable, and
-                    // buffer can't go away because the global log lock is held.
-                    pthread_mutex_unlock(&buffer->lock);
-                    pthread_mutex_lock(&root->log_file_lock);
-                    if (root->log_file_thread_active) {
-                        pthread_cond_wait(&root->log_file_wakeup,
-                                          &root->log_file_lock);
-                    } else {
-                        dead = true;
-                    }
-                    pthread_mutex_unlock(&root->log_file_lock);
-                    pthread_mutex_lock(&buffer->lock);
-                }
-            }
             if (buffer->num_entries == buffer->capacity) {
                 struct mp_log_buffer_entry *skip = log_buffer_read(buffer);
                 talloc_free(skip);
@@ -390,11 +391,165 @@ static void write_msg_to_buffers(struct mp_log *log, int lev, char *text)
     }
 }
 
+// Queue a line for the log file thread. Never blocks; if the queue is full, the
+// message is dropped (or cut off), and the log file thread reports it later.
+static void write_msg_to_log_file(struct mp_log *log, int lev, char *text)
+{
+    struct mp_log_root *root = log->root;
+    if (!root->log_file_active || lev == MSGL_STATUS ||
+        lev > MPMAX(log->terminal_level, MSGL_DEBUG))
+        return;
+
+    struct log_file_record rec = {.first = true};
+    int len = snprintf(rec.text, sizeof(rec.text), "[%8.3f][%c][%s] ",
+                       (mp_time_us() - MP_START_TIME) / 1e6,
+                       mp_log_levels[lev][0], log->verbose_prefix);
+    rec.len = MPCLAMP(len, 0, (int)sizeof(rec.text) - 1);
+
+    size_t text_len = strlen(text);
+    while (1) {
+        size_t copy = MPMIN(text_len, sizeof(rec.text) - rec.len);
+        memcpy(rec.text + rec.len, text, copy);
+        rec.len += copy;
+        text += copy;
+        text_len -= copy;
+        if (text_len && rec.len < sizeof(rec.text))
+            continue;
+        // Records of a line stay together, because root->lock is held.
+        if (!mp_mpsc_queue_push(root->log_file_queue, &rec)) {
+            atomic_fetch_add(&root->log_file_dropped, 1);
+            break;
+        }
+        if (!text_len)
+            break;
+        rec.first = false;
+        rec.len = 0;
+    }
+
+    if (atomic_load(&root->log_file_waiting)) {
+        pthread_mutex_lock(&root->log_file_lock);
+        pthread_cond_broadcast(&root->log_file_wakeup);
+        pthread_mutex_unlock(&root->log_file_lock);
+    }
+}
+
+// Binary --dump-stats format. The file starts with STATS_MAGIC and a version
+// byte, followed by records. Each record starts with a type byte. Integers are
+// unsigned LEB128 varints, time is the delta in microseconds to the previous
+// record with a time, and strings are referenced by the ID of the
+// STATS_REC_STRING record that defined them. TOOLS/stats-conv.py reads this.
+#define STATS_MAGIC "mpvstats"
+#define STATS_VERSION 1
+
+enum stats_record {
+    STATS_REC_STRING = 1,   // ID, length, bytes (IDs are assigned from 0 up)
+    STATS_REC_EVENT,        // time, string ID (MP_STATS() text)
+    STATS_REC_VALUE,        // time, name string ID, little endian float64
+                            // (MP_STATS() "value <float> <name>")
+};
+
+static void put_varint(bstr *buf, uint64_t v)
+{
+    do {
+        buf->start[buf->len++] = (v & 0x7F) | (v >= 0x80 ? 0x80 : 0);
+        v >>= 7;
+    } while (v);
+}
+
+static void put_stats_time(struct mp_log_root *root, bstr *buf)
+{
+    int64_t now = mp_time_us();
+    put_varint(buf, MPMAX(now - root->stats_last_time, 0));
+    root->stats_last_time = MPMAX(now, root->stats_last_time);
+}
+
+static uint32_t stats_hash_str(bstr s)
+{
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t n = 0; n < s.len; n++)
+        h = (h ^ s.start[n]) * 16777619u;
+    return h;
+}
+
+static int *stats_hash_find(struct mp_log_root *root, bstr s)
+{
+    int mask = root->stats_hash_size - 1;
+    int *entry = &root->stats_hash[stats_hash_str(s) & mask];
+    while (*entry && !bstr_equals0(s, root->stats_strings[*entry - 1]))
+        entry = &root->stats_hash[(entry - root->stats_hash + 1) & mask];
+    return entry;
+}
+
+// Return the ID of the string, and define it in the file if it's new.
+static int stats_intern(struct mp_log_root *root, bstr s)
+{
+    if (root->num_stats_strings * 2 >= root->stats_hash_size) {
+        int *old = root->stats_hash;
+        root->stats_hash_size = MPMAX(root->stats_hash_size * 2, 64);
+        root->stats_hash = talloc_zero_array(root, int, root->stats_hash_size);
+        for (int n = 0; n < root->num_stats_strings; n++)
+            *stats_hash_find(root, bstr0(root->stats_strings[n])) = n + 1;
+        talloc_free(old);
+    }
+
+    int *entry = stats_hash_find(root, s);
+    if (*entry)
+        return *entry - 1;
+
+    int id = root->num_stats_strings;
+    MP_TARRAY_APPEND(root, root->stats_strings, root->num_stats_strings,
+                     bstrdup0(root, s));
+    *entry = id + 1;
+
+    uint8_t head[1 + 2 * 10];
+    bstr buf = {head, 0};
+    buf.start[buf.len++] = STATS_REC_STRING;
+    put_varint(&buf, id);
+    put_varint(&buf, s.len);
+    fwrite(buf.start, buf.len, 1, root->stats_file);
+    fwrite(s.start, s.len, 1, root->stats_file);
+    return id;
+}
+
+static void dump_stats_binary(struct mp_log_root *root, char *text)
+{
+    uint8_t data[1 + 3 * 10 + 8];
+    bstr buf = {data, 0};
+
+    bstr rest = bstr0(text);
+    if (bstr_eatstart0(&rest, "value ")) {
+        double v = bstrtod(rest, &rest);
+        if (bstr_eatstart0(&rest, " ") && rest.len) {
+            int id = stats_intern(root, rest);
+            buf.start[buf.len++] = STATS_REC_VALUE;
+            put_stats_time(root, &buf);
+            put_varint(&buf, id);
+            uint64_t bits;
+            memcpy(&bits, &v, sizeof(bits));
+            for (int n = 0; n < 8; n++)
+                buf.start[buf.len++] = bits >> (n * 8);
+            fwrite(buf.start, buf.len, 1, root->stats_file);
+            return;
+        }
+    }
+
+    int id = stats_intern(root, bstr0(text));
+    buf.start[buf.len++] = STATS_REC_EVENT;
+    put_stats_time(root, &buf);
+    put_varint(&buf, id);
+    fwrite(buf.start, buf.len, 1, root->stats_file);
+}
+
 static void dump_stats(struct mp_log *log, int lev, char *text)
 {
     struct mp_log_root *root = log->root;
-    if (lev == MSGL_STATS && root->stats_file)
+    if (lev != MSGL_STATS || !root->stats_file)
+        return;
+    if (root->stats_binary) {
+        dump_stats_binary(root, text);
+    } else {
         fprintf(root->stats_file, "%"PRId64" %s\n", mp_time_us(), text);
+    }
 }
 
 void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
@@ -435,6 +590,7 @@ void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
             next[0] = '\0';
             print_terminal_line(log, lev, text, "");
             write_msg_to_buffers(log, lev, text);
+            write_msg_to_log_file(log, lev, text);
             next[0] = saved;
             text = next;
         }
@@ -526,44 +682,66 @@ void mp_msg_init(struct mpv_global *global)
     global->log = log;
 }
 
+// Write all queued records to the log file. Returns false if there were none.
+static bool write_log_file_records(struct mp_log_root *root,
+                                   struct mp_mpsc_queue *queue, bool *in_line)
+{
+    bool written = false;
+    struct log_file_record rec;
+    while (mp_mpsc_queue_pop(queue, &rec)) {
+        // The rest of the previous line was dropped.
+        if (rec.first && *in_line)
+            fputc('\n', root->log_file);
+        fwrite(rec.text, rec.len, 1, root->log_file);
+        *in_line = rec.len && rec.text[rec.len - 1] != '\n';
+        written = true;
+    }
+
+    uint64_t dropped = atomic_exchange(&root->log_file_dropped, 0);
+    if (dropped) {
+        fprintf(root->log_file, "%s[%8.3f][f][overflow] log file buffer "
+                "overflow: %"PRIu64" messages skipped\n", *in_line ? "\n" : "",
+                (mp_time_us() - MP_START_TIME) / 1e6, dropped);
+        *in_line = false;
+        written = true;
+    }
+
+    if (written)
+        fflush(root->log_file);
+    return written;
+}
+
 static void *log_file_thread(void *p)
 {
     struct mp_log_root *root = p;
+    struct mp_mpsc_queue *queue = root->log_file_queue;
+    bool in_line = false;
 
     mpthread_set_name("log-file");
 
     pthread_mutex_lock(&root->log_file_lock);
 
     while (root->log_file_thread_active) {
-        struct mp_log_buffer_entry *e =
-            mp_msg_log_buffer_read(root->log_file_buffer);
-        if (e) {
-            pthread_mutex_unlock(&root->log_file_lock);
-            fprintf(root->log_file, "[%8.3f][%c][%s] %s",
-                    (mp_time_us() - MP_START_TIME) / 1e6,
-                    mp_log_levels[e->level][0], e->prefix, e->text);
-            fflush(root->log_file);
-            pthread_mutex_lock(&root->log_file_lock);
-            talloc_free(e);
-            // Multiple threads might be blocked if the log buffer was full.
-            pthread_cond_broadcast(&root->log_file_wakeup);
-        } else {
-            pthread_cond_wait(&root->log_file_wakeup, &root->log_file_lock);
+        pthread_mutex_unlock(&root->log_file_lock);
+        bool written = write_log_file_records(root, queue, &in_line);
+        pthread_mutex_lock(&root->log_file_lock);
+        if (!written) {
+            // Check again after setting the flag, to make sure a concurrent
+            // write_msg_to_log_file() either sees the flag or its record is
+            // seen here.
+            atomic_store(&root->log_file_waiting, true);
+            if (!mp_mpsc_queue_peek(queue) && root->log_file_thread_active)
+                pthread_cond_wait(&root->log_file_wakeup, &root->log_file_lock);
+            atomic_store(&root->log_file_waiting, false);
         }
     }
 
     pthread_mutex_unlock(&root->log_file_lock);
 
-    return NULL;
-}
-
-static void wakeup_log_file(void *p)
-{
-    struct mp_log_root *root = p;
+    // Producers were stopped before termination; write out the rest.
+    write_log_file_records(root, queue, &in_line);
 
-    pthread_mutex_lock(&root->log_file_lock);
-    pthread_cond_broadcast(&root->log_file_wakeup);
-    pthread_mutex_unlock(&root->log_file_lock);
+    return NULL;
 }
 
 // Only to be called from the main thread.
@@ -571,6 +749,12 @@ static void terminate_log_file_thread(struct mp_log_root *root)
 {
     bool wait_terminate = false;
 
+    // Stop queuing new messages.
+    pthread_mutex_lock(&root->lock);
+    root->log_file_active = false;
+    atomic_fetch_add(&root->reload_counter, 1);
+    pthread_mutex_unlock(&root->lock);
+
     pthread_mutex_lock(&root->log_file_lock);
     if (root->log_file_thread_active) {
         root->log_file_thread_active = false;
@@ -582,8 +766,8 @@ static void terminate_log_file_thread(struct mp_log_root *root)
     if (wait_terminate)
         pthread_join(root->log_file_thread, NULL);
 
-    mp_msg_log_buffer_destroy(root->log_file_buffer);
-    root->log_file_buffer = NULL;
+    talloc_free(root->log_file_queue);
+    root->log_file_queue = NULL;
 
     if (root->log_file)
         fclose(root->log_file);
@@ -641,15 +825,20 @@ void mp_msg_update_msglevels(struct mpv_global *global, struct MPOpts *opts)
         if (root->log_path) {
             root->log_file = fopen(root->log_path, "wb");
             if (root->log_file) {
-                root->log_file_buffer =
-                    mp_msg_log_buffer_new(global, 100, MP_LOG_BUFFER_MSGL_LOGFILE,
-                                          wakeup_log_file, root);
+                root->log_file_queue =
+                    mp_mpsc_queue_create(NULL, sizeof(struct log_file_record),
+                                         LOG_FILE_QUEUE);
                 root->log_file_thread_active = true;
                 if (pthread_create(&root->log_file_thread, NULL, log_file_thread,
                                    root))
                 {
                     root->log_file_thread_active = false;
                     terminate_log_file_thread(root);
+                } else {
+                    pthread_mutex_lock(&root->lock);
+                    root->log_file_active = true;
+                    atomic_fetch_add(&root->reload_counter, 1);
+                    pthread_mutex_unlock(&root->lock);
                 }
             } else {
                 mp_err(global->log, "Failed to open log file '%s'\n",
@@ -658,16 +847,32 @@ void mp_msg_update_msglevels(struct mpv_global *global, struct MPOpts *opts)
         }
     }
 
-    if (check_new_path(global, opts->dump_stats, &root->stats_path)) {
+    bool new_stats_format = root->stats_format != opts->dump_stats_format;
+    root->stats_format = opts->dump_stats_format;
+    if (check_new_path(global, opts->dump_stats, &root->stats_path) ||
+        new_stats_format)
+    {
         bool open_error = false;
 
         pthread_mutex_lock(&root->lock);
         if (root->stats_file)
             fclose(root->stats_file);
         root->stats_file = NULL;
+        root->stats_binary = root->stats_format == 1;
+        root->stats_last_time = 0;
+        talloc_free(root->stats_strings);
+        root->stats_strings = NULL;
+        root->num_stats_strings = 0;
+        talloc_free(root->stats_hash);
+        root->stats_hash = NULL;
+        root->stats_hash_size = 0;
         if (root->stats_path) {
             root->stats_file = fopen(root->stats_path, "wb");
             open_error = !root->stats_file;
+            if (root->stats_file && root->stats_binary) {
+                fwrite(STATS_MAGIC, strlen(STATS_MAGIC), 1, root->stats_file);
+                fputc(STATS_VERSION, root->stats_file);
+            }
         }
         pthread_mutex_unlock(&root->lock);
 
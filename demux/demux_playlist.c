@@ -19,14 +19,17 @@
 #include <string.h>
 #include <strings.h>
 #include <dirent.h>
+#include <pthread.h>
 
 #include <libavutil/common.h>
 
 #include "config.h"
 #include "common/common.h"
+#include "options/m_config.h"
 #include "options/options.h"
 #include "common/msg.h"
 #include "common/playlist.h"
+#include "misc/thread_pool.h"
 #include "misc/thread_tools.h"
 #include "options/path.h"
 #include "stream/stream.h"
@@ -36,6 +39,31 @@
 
 #define PROBE_SIZE (8 * 1024)
 
+enum dir_mode {
+    DIR_RECURSIVE,
+    DIR_LAZY,
+    DIR_IGNORE,
+};
+
+struct demux_playlist_opts {
+    int dir_mode;
+};
+
+#define OPT_BASE_STRUCT struct demux_playlist_opts
+const struct m_sub_options demux_playlist_conf = {
+    .opts = (const struct m_option[]) {
+        {"directory-mode", OPT_CHOICE(dir_mode,
+            {"recursive", DIR_RECURSIVE},
+            {"lazy", DIR_LAZY},
+            {"ignore", DIR_IGNORE})},
+        {0}
+    },
+    .size = sizeof(struct demux_playlist_opts),
+    .defaults = &(const struct demux_playlist_opts){
+        .dir_mode = DIR_RECURSIVE,
+    },
+};
+
 static bool check_mimetype(struct stream *s, const char *const *list)
 {
     if (s->mime_type) {
@@ -60,6 +88,7 @@ struct pl_parser {
     enum demux_check check_level;
     struct stream *real_stream;
     char *format;
+    struct demux_playlist_opts *opts;
 };
 
 
@@ -305,23 +334,118 @@ static int parse_txt(struct pl_parser *p)
 
 #define MAX_DIR_STACK 20
 
+// Number of threads used to read sub-directories in parallel with
+// --directory-mode=recursive. Reading directories is mostly waiting for the
+// filesystem, so this is not related to the number of CPUs.
+#define MAX_SCAN_THREADS 8
+
 static bool same_st(struct stat *st1, struct stat *st2)
 {
     return st1->st_dev == st2->st_dev && st1->st_ino == st2->st_ino;
 }
 
-// Return true if this was a readable directory.
-static bool scan_dir(struct pl_parser *p, char *path,
-                     struct stat *dir_stack, int num_dir_stack,
-                     char ***files, int *num_files)
+// Shared state of a recursive directory scan.
+struct dir_scanner {
+    struct pl_parser *p;
+    struct mp_thread_pool *pool;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    int pending;        // number of queued/running scan_dir() calls
+    // The opened directory and its parent directories. Sub-directories added
+    // with the lazy mode are expanded by a new parse_dir() call, so loops
+    // across expansions are detected with this.
+    struct stat ancestors[MAX_DIR_STACK];
+    int num_ancestors;
+};
+
+// One directory. Each directory is read by a single thread, and the results
+// are only accessed by the parser thread after the scan has finished. Since
+// talloc is not thread-safe, these are not allocated under their parent
+// directory, but stolen by it in collect_files().
+struct dir_scan {
+    struct dir_scanner *sc;
+    char *path;
+    struct stat dir_stack[MAX_DIR_STACK];
+    int num_dir_stack;
+    char **files;
+    int num_files;
+    struct dir_scan **subdirs;
+    int num_subdirs;
+};
+
+static void scan_dir(void *arg);
+
+static bool is_dir_loop(struct dir_scan *scan, struct stat *st)
+{
+    struct dir_scanner *sc = scan->sc;
+    for (int n = 0; n < scan->num_dir_stack; n++) {
+        if (same_st(&scan->dir_stack[n], st))
+            return true;
+    }
+    for (int n = 0; n < sc->num_ancestors; n++) {
+        if (same_st(&sc->ancestors[n], st))
+            return true;
+    }
+    return false;
+}
+
+static void get_ancestors(struct dir_scanner *sc, void *ta_parent,
+                          const char *path)
+{
+    char *dir = talloc_strdup(ta_parent, path);
+    if (strlen(dir) > 1)
+        mp_path_strip_trailing_separator(dir);
+    while (sc->num_ancestors < MAX_DIR_STACK) {
+        struct stat st;
+        if (stat(dir, &st) != 0)
+            break;
+        sc->ancestors[sc->num_ancestors++] = st;
+        char *parent = bstrto0(ta_parent, mp_dirname(dir));
+        if (strlen(parent) > 1)
+            mp_path_strip_trailing_separator(parent);
+        if (strcmp(parent, dir) == 0)
+            break;
+        dir = parent;
+    }
+}
+
+static void queue_scan(struct dir_scanner *sc, struct dir_scan *scan)
 {
-    if (strlen(path) >= 8192 || num_dir_stack == MAX_DIR_STACK)
-        return false; // things like mount bind loops
+    pthread_mutex_lock(&sc->lock);
+    sc->pending++;
+    pthread_mutex_unlock(&sc->lock);
+
+    if (!sc->pool || !mp_thread_pool_queue(sc->pool, scan_dir, scan))
+        scan_dir(scan);
+}
+
+// Determine whether the entry is a directory, and get its stat if it is. This
+// avoids stat() calls for plain files if readdir() returns the file type,
+// which matters a lot with network filesystems.
+static bool is_dir_entry(struct dirent *ep, const char *file, struct stat *st)
+{
+#ifdef DT_DIR
+    if (ep->d_type != DT_DIR && ep->d_type != DT_LNK && ep->d_type != DT_UNKNOWN)
+        return false;
+#endif
+    return stat(file, st) == 0 && S_ISDIR(st->st_mode);
+}
 
-    DIR *dp = opendir(path);
+static void scan_dir(void *arg)
+{
+    struct dir_scan *scan = arg;
+    struct dir_scanner *sc = scan->sc;
+    struct pl_parser *p = sc->p;
+    int mode = p->opts->dir_mode;
+
+    DIR *dp = NULL;
+    if (strlen(scan->path) >= 8192 || scan->num_dir_stack == MAX_DIR_STACK)
+        goto done; // things like mount bind loops
+
+    dp = opendir(scan->path);
     if (!dp) {
         MP_ERR(p, "Could not read directory.\n");
-        return false;
+        goto done;
     }
 
     struct dirent *ep;
@@ -332,28 +456,54 @@ static bool scan_dir(struct pl_parser *p, char *path,
         if (mp_cancel_test(p->s->cancel))
             break;
 
-        char *file = mp_path_join(p, path, ep->d_name);
+        char *file = mp_path_join(scan, scan->path, ep->d_name);
 
         struct stat st;
-        if (stat(file, &st) == 0 && S_ISDIR(st.st_mode)) {
-            for (int n = 0; n < num_dir_stack; n++) {
-                if (same_st(&dir_stack[n], &st)) {
-                    MP_VERBOSE(p, "Skip recursive entry: %s\n", file);
-                    goto skip;
-                }
+        if (is_dir_entry(ep, file, &st)) {
+            if (mode == DIR_IGNORE) {
+                MP_VERBOSE(p, "Ignoring directory: %s\n", file);
+                continue;
+            }
+            if (is_dir_loop(scan, &st)) {
+                MP_VERBOSE(p, "Skip recursive entry: %s\n", file);
+                continue;
+            }
+            if (mode == DIR_LAZY) {
+                MP_TARRAY_APPEND(scan, scan->files, scan->num_files, file);
+                continue;
             }
 
-            dir_stack[num_dir_stack] = st;
-            scan_dir(p, file, dir_stack, num_dir_stack + 1, files, num_files);
+            struct dir_scan *sub = talloc_zero(NULL, struct dir_scan);
+            sub->sc = sc;
+            sub->path = file;
+            memcpy(sub->dir_stack, scan->dir_stack, sizeof(sub->dir_stack));
+            sub->dir_stack[scan->num_dir_stack] = st;
+            sub->num_dir_stack = scan->num_dir_stack + 1;
+            MP_TARRAY_APPEND(scan, scan->subdirs, scan->num_subdirs, sub);
+            queue_scan(sc, sub);
         } else {
-            MP_TARRAY_APPEND(p, *files, *num_files, file);
+            MP_TARRAY_APPEND(scan, scan->files, scan->num_files, file);
         }
-
-        skip: ;
     }
 
     closedir(dp);
-    return true;
+
+done:
+    pthread_mutex_lock(&sc->lock);
+    sc->pending--;
+    pthread_cond_broadcast(&sc->wakeup);
+    pthread_mutex_unlock(&sc->lock);
+}
+
+static void collect_files(struct dir_scan *scan, void *ta_parent,
+                          char ***files, int *num_files)
+{
+    for (int n = 0; n < scan->num_files; n++)
+        MP_TARRAY_APPEND(ta_parent, *files, *num_files, scan->files[n]);
+    for (int n = 0; n < scan->num_subdirs; n++) {
+        talloc_steal(scan, scan->subdirs[n]);
+        collect_files(scan->subdirs[n], ta_parent, files, num_files);
+    }
 }
 
 static int cmp_filename(const void *a, const void *b)
@@ -372,11 +522,34 @@ static int parse_dir(struct pl_parser *p)
     if (!path)
         return -1;
 
+    struct dir_scanner sc = {
+        .p = p,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .wakeup = PTHREAD_COND_INITIALIZER,
+    };
+    // Sub-directories are only read with the recursive mode. If the pool is
+    // missing, they are read on the calling thread.
+    if (p->opts->dir_mode == DIR_RECURSIVE)
+        sc.pool = mp_thread_pool_create(NULL, 0, 1, MAX_SCAN_THREADS);
+
+    struct dir_scan *root = talloc_zero(NULL, struct dir_scan);
+    get_ancestors(&sc, root, path);
+    root->sc = &sc;
+    root->path = path;
+    queue_scan(&sc, root);
+
+    pthread_mutex_lock(&sc.lock);
+    while (sc.pending)
+        pthread_cond_wait(&sc.wakeup, &sc.lock);
+    pthread_mutex_unlock(&sc.lock);
+
+    talloc_free(sc.pool);
+    pthread_cond_destroy(&sc.wakeup);
+    pthread_mutex_destroy(&sc.lock);
+
     char **files = NULL;
     int num_files = 0;
-    struct stat dir_stack[MAX_DIR_STACK];
-
-    scan_dir(p, path, dir_stack, 0, &files, &num_files);
+    collect_files(root, root, &files, &num_files);
 
     if (files)
         qsort(files, num_files, sizeof(files[0]), cmp_filename);
@@ -384,6 +557,8 @@ static int parse_dir(struct pl_parser *p)
     for (int n = 0; n < num_files; n++)
         playlist_add_file(p->pl, files[n]);
 
+    talloc_free(root);
+
     p->add_base = false;
 
     return num_files > 0 ? 0 : -1;
@@ -438,6 +613,7 @@ static int open_file(struct demuxer *demuxer, enum demux_check check)
     p->pl = talloc_zero(p, struct playlist);
     p->real_stream = demuxer->stream;
     p->add_base = true;
+    p->opts = mp_get_config_group(p, demuxer->global, &demux_playlist_conf);
 
     char probe[PROBE_SIZE];
     int probe_len = stream_read_peek(p->real_stream, probe, sizeof(probe));
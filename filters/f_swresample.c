@@ -36,6 +36,35 @@
 #include "f_swresample.h"
 #include "filter_internal.h"
 
+// Max. number of inactive, but fully configured resamplers to keep around.
+#define MAX_CACHED_CTX 4
+
+// Parameters a resampler context was configured for.
+struct lavrr_key {
+    int in_rate;        // actual rate, adjusted for playback speed
+    int in_format;
+    struct mp_chmap in_channels;
+    int out_rate;
+    int out_format;
+    struct mp_chmap out_channels;
+};
+
+// An inactive resampler context. Switching back to a previously used
+// configuration (e.g. playlists mixing 44.1 and 48 kHz, or toggling playback
+// speed with audio-pitch-correction=no) reuses it instead of rebuilding it,
+// which in particular avoids recomputing the resampler filter bank.
+struct lavrr_ctx {
+    struct lavrr_key key;
+    bool is_resampling;
+    struct SwrContext *avrctx;
+    struct mp_aframe *avrctx_fmt;
+    struct mp_aframe *pool_fmt;
+    struct mp_aframe *pre_out_fmt;
+    struct SwrContext *avrctx_out;
+    int *reorder_in;
+    int reorder_out[MP_NUM_CHANNELS];
+};
+
 struct priv {
     struct mp_log *log;
     bool is_resampling;
@@ -44,10 +73,15 @@ struct priv {
     struct mp_aframe *pool_fmt; // format used to allocate frames for avrctx output
     struct mp_aframe *pre_out_fmt; // format before final conversion
     struct SwrContext *avrctx_out; // for output channel reordering
+    struct lavrr_key avrctx_key; // what avrctx was configured for
     struct mp_resample_opts *opts; // opts requested by the user
-    // At least libswresample keeps a pointer around for this:
-    int reorder_in[MP_NUM_CHANNELS];
+    // At least libswresample keeps a pointer around for this, so it's
+    // allocated separately and moves along with avrctx into the cache.
+    int *reorder_in;
     int reorder_out[MP_NUM_CHANNELS];
+    // Most recently used first.
+    struct lavrr_ctx *cache[MAX_CACHED_CTX];
+    int num_cache;
     struct mp_aframe_pool *reorder_buffer;
     struct mp_aframe_pool *out_pool;
 
@@ -103,6 +137,102 @@ static void close_lavrr(struct priv *p)
     TA_FREEP(&p->pre_out_fmt);
     TA_FREEP(&p->avrctx_fmt);
     TA_FREEP(&p->pool_fmt);
+    TA_FREEP(&p->reorder_in);
+}
+
+static void destroy_lavrr_ctx(void *ptr)
+{
+    struct lavrr_ctx *c = ptr;
+
+    swr_free(&c->avrctx);
+    swr_free(&c->avrctx_out);
+}
+
+static void clear_cache(struct priv *p)
+{
+    for (int n = 0; n < p->num_cache; n++)
+        talloc_free(p->cache[n]);
+    p->num_cache = 0;
+}
+
+static bool key_equals(struct lavrr_key *a, struct lavrr_key *b)
+{
+    return a->in_rate == b->in_rate &&
+           a->in_format == b->in_format &&
+           mp_chmap_equals(&a->in_channels, &b->in_channels) &&
+           a->out_rate == b->out_rate &&
+           a->out_format == b->out_format &&
+           mp_chmap_equals(&a->out_channels, &b->out_channels);
+}
+
+// Like close_lavrr(), but move the active resampler into the cache.
+static void stash_lavrr(struct priv *p)
+{
+    if (!p->avrctx || !p->avrctx_out || !p->reorder_in) {
+        close_lavrr(p);
+        return;
+    }
+
+    struct lavrr_ctx *c = talloc_ptrtype(p, c);
+    *c = (struct lavrr_ctx){
+        .key = p->avrctx_key,
+        .is_resampling = p->is_resampling,
+        .avrctx = p->avrctx,
+        .avrctx_fmt = talloc_steal(c, p->avrctx_fmt),
+        .pool_fmt = talloc_steal(c, p->pool_fmt),
+        .pre_out_fmt = talloc_steal(c, p->pre_out_fmt),
+        .avrctx_out = p->avrctx_out,
+        .reorder_in = talloc_steal(c, p->reorder_in),
+    };
+    memcpy(c->reorder_out, p->reorder_out, sizeof(c->reorder_out));
+    talloc_set_destructor(c, destroy_lavrr_ctx);
+
+    p->avrctx = p->avrctx_out = NULL;
+    p->avrctx_fmt = p->pool_fmt = p->pre_out_fmt = NULL;
+    p->reorder_in = NULL;
+
+    if (p->num_cache == MAX_CACHED_CTX)
+        talloc_free(p->cache[--p->num_cache]);
+    memmove(&p->cache[1], &p->cache[0], p->num_cache * sizeof(p->cache[0]));
+    p->cache[0] = c;
+    p->num_cache++;
+}
+
+// Make a cached resampler matching key the active one. Its state is reset,
+// which (unlike swr_free()/swr_alloc()) keeps the resampler filter bank.
+static bool restore_lavrr(struct priv *p, struct lavrr_key *key)
+{
+    for (int n = 0; n < p->num_cache; n++) {
+        struct lavrr_ctx *c = p->cache[n];
+        if (!key_equals(&c->key, key))
+            continue;
+
+        p->num_cache--;
+        memmove(&p->cache[n], &p->cache[n + 1],
+                (p->num_cache - n) * sizeof(p->cache[0]));
+
+        swr_close(c->avrctx);
+        swr_close(c->avrctx_out);
+        if (swr_init(c->avrctx) < 0 || swr_init(c->avrctx_out) < 0) {
+            talloc_free(c);
+            return false;
+        }
+
+        p->avrctx_key = c->key;
+        p->is_resampling = c->is_resampling;
+        p->avrctx = c->avrctx;
+        p->avrctx_fmt = talloc_steal(p, c->avrctx_fmt);
+        p->pool_fmt = talloc_steal(p, c->pool_fmt);
+        p->pre_out_fmt = talloc_steal(p, c->pre_out_fmt);
+        p->avrctx_out = c->avrctx_out;
+        p->reorder_in = talloc_steal(p, c->reorder_in);
+        memcpy(p->reorder_out, c->reorder_out, sizeof(p->reorder_out));
+
+        c->avrctx = c->avrctx_out = NULL;
+        talloc_free(c);
+        return true;
+    }
+    return false;
 }
 
 static int rate_from_speed(int rate, double speed)
@@ -159,7 +289,7 @@ static void transpose_order(int *map, int num)
 
 static bool configure_lavrr(struct priv *p, bool verbose)
 {
-    close_lavrr(p);
+    stash_lavrr(p);
 
     p->in_rate = rate_from_speed(p->in_rate_user, p->speed);
 
@@ -169,8 +299,23 @@ static bool configure_lavrr(struct priv *p, bool verbose)
                p->out_rate, mp_chmap_to_str(&p->out_channels),
                af_fmt_to_str(p->out_format));
 
+    struct lavrr_key key = {
+        .in_rate = p->in_rate,
+        .in_format = p->in_format,
+        .in_channels = p->in_channels,
+        .out_rate = p->out_rate,
+        .out_format = p->out_format,
+        .out_channels = p->out_channels,
+    };
+
+    if (restore_lavrr(p, &key)) {
+        MP_VERBOSE(p, "Reusing cached resampler.\n");
+        return true;
+    }
+
     p->avrctx = swr_alloc();
     p->avrctx_out = swr_alloc();
+    p->reorder_in = talloc_zero_array(p, int, MP_NUM_CHANNELS);
     if (!p->avrctx || !p->avrctx_out)
         goto error;
 
@@ -304,6 +449,7 @@ static bool configure_lavrr(struct priv *p, bool verbose)
         MP_ERR(p, "Cannot open Libavresample context.\n");
         goto error;
     }
+    p->avrctx_key = key;
     return true;
 
 error:
@@ -635,6 +781,7 @@ static void destroy(struct mp_filter *f)
     struct priv *p = f->priv;
 
     close_lavrr(p);
+    clear_cache(p);
     TA_FREEP(&p->input);
 }
 
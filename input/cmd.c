@@ -451,7 +451,8 @@ error:
 
 mp_cmd_t *mp_input_parse_cmd_str(struct mp_log *log, bstr str, const char *loc)
 {
-    void *tmp = talloc_new(NULL);
+    // Only holds unescaped argument strings, which are copied by the parser.
+    void *tmp = talloc_new_arena(NULL);
     bstr original = str;
     struct mp_cmd *cmd = parse_cmd_str(log, tmp, &str, loc);
     if (!cmd)
@@ -40,6 +40,7 @@
 #include "osdep/timer.h"
 #include "common/msg.h"
 #include "common/global.h"
+#include "common/stats.h"
 #include "options/m_config.h"
 #include "options/m_option.h"
 #include "options/path.h"
@@ -73,6 +74,12 @@ struct cmd_bind_section {
     char *owner;
     struct cmd_bind *binds;
     int num_binds;
+    // Hash index over binds[], keyed by the last key of each key sequence.
+    // bind_index[hash] is the first bind of a chain continued by bind_next[],
+    // -1 terminates a chain. Rebuilt lazily if bind_index_size is 0.
+    int *bind_index;
+    int *bind_next;
+    int bind_index_size;    // power of 2
     char *section;
     struct mp_rect mouse_area;  // set at runtime, if at all
     bool mouse_area_set;        // mouse_area is valid and should be tested
@@ -85,6 +92,7 @@ struct cmd_bind_section {
 struct active_section {
     char *name;
     int flags;
+    struct cmd_bind_section *bs;
 };
 
 struct cmd_queue {
@@ -100,6 +108,7 @@ struct input_ctx {
     pthread_mutex_t mutex;
     struct mp_log *log;
     struct mpv_global *global;
+    struct stats_ctx *stats;
     struct m_config_cache *opts_cache;
     struct input_opts *opts;
 
@@ -376,57 +385,99 @@ static void key_buf_add(int *buf, int code)
     buf[0] = code;
 }
 
-static struct cmd_bind *find_bind_for_key_section(struct input_ctx *ictx,
-                                                  char *section, int code)
+static unsigned int bind_index_hash(struct cmd_bind_section *bs, int key)
+{
+    uint32_t h = (uint32_t)key * 0x9E3779B1u;
+    return (h ^ (h >> 16)) & (bs->bind_index_size - 1);
+}
+
+static void invalidate_bind_index(struct cmd_bind_section *bs)
+{
+    bs->bind_index_size = 0;
+}
+
+static void update_bind_index(struct cmd_bind_section *bs)
 {
-    struct cmd_bind_section *bs = get_bind_section(ictx, bstr0(section));
+    if (bs->bind_index_size)
+        return;
 
+    int size = 16;
+    while (size < bs->num_binds * 2)
+        size *= 2;
+    bs->bind_index_size = size;
+    bs->bind_index = talloc_realloc(bs, bs->bind_index, int, size);
+    for (int n = 0; n < size; n++)
+        bs->bind_index[n] = -1;
+    bs->bind_next = talloc_realloc(bs, bs->bind_next, int,
+                                   MPMAX(bs->num_binds, 1));
+
+    // Insert in reverse, so that chains are ordered like binds[].
+    for (int n = bs->num_binds - 1; n >= 0; n--) {
+        struct cmd_bind *b = &bs->binds[n];
+        if (!b->num_keys) {
+            bs->bind_next[n] = -1;
+            continue;
+        }
+        unsigned int h = bind_index_hash(bs, b->keys[b->num_keys - 1]);
+        bs->bind_next[n] = bs->bind_index[h];
+        bs->bind_index[h] = n;
+    }
+}
+
+static struct cmd_bind *find_bind_for_key_section(struct input_ctx *ictx,
+                                                  struct cmd_bind_section *bs,
+                                                  int code)
+{
     if (!bs->num_binds)
         return NULL;
 
+    update_bind_index(bs);
+
     int keys[MP_MAX_KEY_DOWN];
     memcpy(keys, ictx->key_history, sizeof(keys));
     key_buf_add(keys, code);
 
-    struct cmd_bind *best = NULL;
-
     // Prefer user-defined keys over builtin bindings
-    for (int builtin = 0; builtin < 2; builtin++) {
-        if (builtin && !ictx->opts->default_bindings)
-            break;
-        if (best)
-            break;
-        for (int n = 0; n < bs->num_binds; n++) {
-            if (bs->binds[n].is_builtin == (bool)builtin) {
-                struct cmd_bind *b = &bs->binds[n];
-                // we have: keys=[key2 key1 keyX ...]
-                // and: b->keys=[key1 key2] (and may be just a prefix)
-                for (int i = 0; i < b->num_keys; i++) {
-                    if (b->keys[i] != keys[b->num_keys - 1 - i])
-                        goto skip;
-                }
-                if (!best || b->num_keys >= best->num_keys)
-                    best = b;
-            skip: ;
-            }
+    struct cmd_bind *best[2] = {0};
+
+    // Only binds whose last key is the new key can match.
+    int n = bs->bind_index[bind_index_hash(bs, code)];
+    for (; n >= 0; n = bs->bind_next[n]) {
+        struct cmd_bind *b = &bs->binds[n];
+        // we have: keys=[key2 key1 keyX ...]
+        // and: b->keys=[key1 key2] (and may be just a prefix)
+        for (int i = 0; i < b->num_keys; i++) {
+            if (b->keys[i] != keys[b->num_keys - 1 - i])
+                goto skip;
         }
+        struct cmd_bind **pbest = &best[b->is_builtin];
+        if (!*pbest || b->num_keys >= (*pbest)->num_keys)
+            *pbest = b;
+    skip: ;
     }
-    return best;
+
+    if (!best[0] && ictx->opts->default_bindings)
+        return best[1];
+    return best[0];
 }
 
 static struct cmd_bind *find_any_bind_for_key(struct input_ctx *ictx,
                                               char *force_section, int code)
 {
-    if (force_section)
-        return find_bind_for_key_section(ictx, force_section, code);
+    if (force_section) {
+        struct cmd_bind_section *bs =
+            get_bind_section(ictx, bstr0(force_section));
+        return find_bind_for_key_section(ictx, bs, code);
+    }
 
     bool use_mouse = MP_KEY_DEPENDS_ON_MOUSE_POS(code);
 
     // First look whether a mouse section is capturing all mouse input
     // exclusively (regardless of the active section stack order).
     if (use_mouse && MP_KEY_IS_MOUSE_BTN_SINGLE(ictx->last_key_down)) {
-        struct cmd_bind *bind =
-            find_bind_for_key_section(ictx, ictx->mouse_section, code);
+        struct cmd_bind_section *bs =
+            get_bind_section(ictx, bstr0(ictx->mouse_section));
+        struct cmd_bind *bind = find_bind_for_key_section(ictx, bs, code);
         if (bind)
             return bind;
     }
@@ -434,7 +485,7 @@ static struct cmd_bind *find_any_bind_for_key(struct input_ctx *ictx,
     struct cmd_bind *best_bind = NULL;
     for (int i = ictx->num_active_sections - 1; i >= 0; i--) {
         struct active_section *s = &ictx->active_sections[i];
-        struct cmd_bind *bind = find_bind_for_key_section(ictx, s->name, code);
+        struct cmd_bind *bind = find_bind_for_key_section(ictx, s->bs, code);
         if (bind) {
             struct cmd_bind_section *bs = bind->owner;
             if (!use_mouse || (bs->mouse_area_set && test_rect(&bs->mouse_area,
@@ -561,6 +612,28 @@ static struct mp_cmd *resolve_key(struct input_ctx *ictx, int code)
     return NULL;
 }
 
+// If the core did not read the command of the previous wheel event yet, and
+// it's the same command, add the new scroll amount to it. This merges bursts
+// of wheel events into one command per playloop iteration. The core was
+// already woken up for the queued command, so no wakeup is needed.
+static bool merge_wheel_cmd(struct input_ctx *ictx, struct mp_cmd *cmd)
+{
+    struct mp_cmd *tail = queue_peek_tail(&ictx->cmd_queue);
+    if (!tail || tail->is_up_down || tail->mouse_move ||
+        !mp_input_is_scalable_cmd(tail) ||
+        tail->input_section != cmd->input_section ||
+        !tail->key_name || !cmd->key_name ||
+        strcmp(tail->key_name, cmd->key_name) != 0 ||
+        strcmp(tail->original, cmd->original) != 0)
+        return false;
+
+    tail->scale += cmd->scale;
+    tail->scale_units += cmd->scale_units;
+    talloc_free(cmd);
+    stats_event(ictx->stats, "wheel-merged");
+    return true;
+}
+
 static void interpret_key(struct input_ctx *ictx, int code, double scale,
                           int scale_units)
 {
@@ -577,7 +650,10 @@ static void interpret_key(struct input_ctx *ictx, int code, double scale,
 
     if (MP_KEY_DEPENDS_ON_MOUSE_POS(code & ~MP_KEY_MODIFIER_MASK)) {
         ictx->mouse_event_counter++;
-        mp_input_wakeup(ictx);
+        // If commands are still queued, the core was woken up for them and
+        // will see the new counter when reading them.
+        if (!ictx->cmd_queue.first)
+            mp_input_wakeup(ictx);
     }
 
     struct mp_cmd *cmd = NULL;
@@ -627,6 +703,9 @@ static void interpret_key(struct input_ctx *ictx, int code, double scale,
     if (mp_input_is_scalable_cmd(cmd)) {
         cmd->scale = scale;
         cmd->scale_units = scale_units;
+        if (MP_KEY_IS_WHEEL(code & ~MP_KEY_MODIFIER_MASK) &&
+            merge_wheel_cmd(ictx, cmd))
+            return;
         mp_input_queue_cmd(ictx, cmd);
     } else {
         // Non-scalable commands won't understand cmd->scale, so synthesize
@@ -784,6 +863,7 @@ void mp_input_put_wheel(struct input_ctx *ictx, int direction, double value)
     if (value == 0.0)
         return;
     input_lock(ictx);
+    stats_event(ictx->stats, "wheel");
     mp_input_feed_key(ictx, direction, value, false);
     input_unlock(ictx);
 }
@@ -830,6 +910,7 @@ void mp_input_set_mouse_pos_artificial(struct input_ctx *ictx, int x, int y)
 {
     input_lock(ictx);
     MP_TRACE(ictx, "mouse move %d/%d\n", x, y);
+    stats_event(ictx->stats, "mouse-move");
 
     if (ictx->mouse_vo_x == x && ictx->mouse_vo_y == y) {
         input_unlock(ictx);
@@ -864,13 +945,17 @@ void mp_input_set_mouse_pos_artificial(struct input_ctx *ictx, int x, int y)
         if (should_drop_cmd(ictx, cmd)) {
             talloc_free(cmd);
         } else {
-            // Coalesce with previous mouse move events (i.e. replace it)
+            // Coalesce with previous mouse move events (i.e. replace it). The
+            // core was already woken up for the replaced command.
             struct mp_cmd *tail = queue_peek_tail(&ictx->cmd_queue);
             if (tail && tail->mouse_move) {
                 queue_remove(&ictx->cmd_queue, tail);
                 talloc_free(tail);
+                queue_add_tail(&ictx->cmd_queue, cmd);
+                stats_event(ictx->stats, "mouse-move-merged");
+            } else {
+                mp_input_queue_cmd(ictx, cmd);
             }
-            mp_input_queue_cmd(ictx, cmd);
         }
     }
     input_unlock(ictx);
@@ -954,6 +1039,7 @@ double mp_input_get_delay(struct input_ctx *ictx)
 
 void mp_input_wakeup(struct input_ctx *ictx)
 {
+    stats_event(ictx->stats, "wakeup");
     ictx->wakeup_cb(ictx->wakeup_ctx);
 }
 
@@ -1024,7 +1110,11 @@ void mp_input_enable_section(struct input_ctx *ictx, char *name, int flags)
             for (int n = ictx->num_active_sections; n > top; n--)
                 ictx->active_sections[n] = ictx->active_sections[n - 1];
         }
-        ictx->active_sections[top] = (struct active_section){name, flags};
+        ictx->active_sections[top] = (struct active_section){
+            .name = name,
+            .flags = flags,
+            .bs = get_bind_section(ictx, bstr0(name)),
+        };
         ictx->num_active_sections++;
     }
 
@@ -1062,7 +1152,7 @@ static bool test_mouse(struct input_ctx *ictx, int x, int y, int rej_flags)
         struct active_section *as = &ictx->active_sections[i];
         if (as->flags & rej_flags)
             continue;
-        struct cmd_bind_section *s = get_bind_section(ictx, bstr0(as->name));
+        struct cmd_bind_section *s = as->bs;
         if (s->mouse_area_set && test_rect(&s->mouse_area, x, y)) {
             res = true;
             break;
@@ -1102,6 +1192,7 @@ static void remove_binds(struct cmd_bind_section *bs, bool builtin)
             assert(bs->num_binds >= 1);
             bs->binds[n] = bs->binds[bs->num_binds - 1];
             bs->num_binds--;
+            invalidate_bind_index(bs);
         }
     }
 }
@@ -1177,6 +1268,7 @@ static void bind_keys(struct input_ctx *ictx, bool builtin, bstr section,
         struct cmd_bind empty = {{0}};
         MP_TARRAY_APPEND(bs, bs->binds, bs->num_binds, empty);
         bind = &bs->binds[bs->num_binds - 1];
+        invalidate_bind_index(bs);
     }
 
     bind_dealloc(bind);
@@ -1319,6 +1411,7 @@ struct input_ctx *mp_input_init(struct mpv_global *global,
         .global = global,
         .ar_state = -1,
         .log = mp_log_new(ictx, global->log, "input"),
+        .stats = stats_ctx_create(ictx, global, "input"),
         .mouse_section = "default",
         .opts_cache = m_config_cache_alloc(ictx, global, &input_config),
         .wakeup_cb = wakeup_cb,
@@ -1467,6 +1560,7 @@ void mp_input_bind_key(struct input_ctx *ictx, int key, bstr command)
         struct cmd_bind empty = {{0}};
         MP_TARRAY_APPEND(bs, bs->binds, bs->num_binds, empty);
         bind = &bs->binds[bs->num_binds - 1];
+        invalidate_bind_index(bs);
     }
 
     bind_dealloc(bind);
@@ -236,4 +236,31 @@ char *mp_json_encode_event(struct mpv_event *event);
 struct mpv_handle;
 char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf);
 
+// IPC wire protocols. All connections start with MP_IPC_JSON, and can switch
+// with the "set_protocol" IPC command.
+enum mp_ipc_protocol {
+    MP_IPC_JSON,    // newline-separated JSON (or text commands)
+    MP_IPC_MSGPACK, // MessagePack, each message prefixed with a 32 bit big
+                    // endian length
+};
+
+// Receives serialized IPC output. Must return <0 on errors.
+typedef int (*mp_ipc_write_fn)(void *ctx, const char *data, size_t len);
+
+// Like mp_json_encode_event(), but for the given protocol, and the output is
+// passed to write in (possibly multiple) chunks. Returns <0 on errors.
+int mp_ipc_write_event(struct mpv_event *event, int protocol,
+                       mp_ipc_write_fn write, void *ctx);
+
+// Return whether buf contains a complete message for the given protocol.
+bool mp_ipc_has_next_message(bstr buf, int protocol);
+
+// Like mp_ipc_consume_next_command(), but for the given protocol, which may be
+// changed by the command. buf must contain a complete message (see
+// mp_ipc_has_next_message()). The reply (if any) is passed to write. Returns
+// <0 on errors.
+int mp_ipc_consume_next_message(struct mpv_handle *client, bstr *buf,
+                                int *protocol, mp_ipc_write_fn write,
+                                void *ctx);
+
 #endif /* MPLAYER_INPUT_H */
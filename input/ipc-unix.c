@@ -49,6 +49,7 @@ struct mp_ipc_ctx {
     struct mp_log *log;
     struct mp_client_api *client_api;
     const char *path;
+    bool multiplex;
 
     pthread_t thread;
     int death_pipe[2];
@@ -64,151 +65,193 @@ struct client_arg {
     bool quit_on_close;
 
     bool writable;
+    bool blocking;      // may block in flush_output() (own thread)
+    int protocol;       // enum mp_ipc_protocol
+
+    int wakeup_fd;      // mpv_get_wakeup_pipe(client)
+    bstr in_buf;        // incomplete command data received from the client
+    bstr out_buf;       // data not yet sent to the client
+    size_t out_pos;     // out_buf.start[0..out_pos] was already sent
 };
 
-static int ipc_write_str(struct client_arg *client, const char *buf)
+static void ignore_sigpipe(void)
 {
-    size_t count = strlen(buf);
-    while (count > 0) {
-        ssize_t rc = send(client->client_fd, buf, count, MSG_NOSIGNAL);
+    // We don't use MSG_NOSIGNAL because the moldy fruit OS doesn't support it.
+    struct sigaction sa = { .sa_handler = SIG_IGN, .sa_flags = SA_RESTART };
+    sigfillset(&sa.sa_mask);
+    sigaction(SIGPIPE, &sa, NULL);
+}
+
+// Flush early if this much output is queued, and the client can block.
+#define MAX_QUEUED_OUTPUT (64 * 1024)
+
+// Disconnect a multiplexed client if this much output is queued, i.e. the
+// client does not read from its socket. JSON replies are serialized into the
+// queue in small chunks, so a large reply is aborted as soon as it would
+// exceed this, instead of being built completely first.
+#define MAX_PENDING_OUTPUT (16 * 1024 * 1024)
+
+static int flush_output(struct client_arg *arg, bool block);
+
+// mp_ipc_write_fn for serializing output directly into the output queue.
+static int queue_output(void *ctx, const char *data, size_t len)
+{
+    struct client_arg *arg = ctx;
+    if (!arg->writable)
+        return 0;
+    if (!arg->blocking) {
+        // Drop the part of the queue that was already sent.
+        if (arg->out_pos) {
+            memmove(arg->out_buf.start, arg->out_buf.start + arg->out_pos,
+                    arg->out_buf.len - arg->out_pos);
+            arg->out_buf.len -= arg->out_pos;
+            arg->out_pos = 0;
+        }
+        if (arg->out_buf.len + len > MAX_PENDING_OUTPUT &&
+            (flush_output(arg, false) < 0 ||
+             arg->out_buf.len + len > MAX_PENDING_OUTPUT))
+        {
+            MP_ERR(arg, "Client does not read its output, disconnecting.\n");
+            errno = ENOBUFS;
+            return -1;
+        }
+    }
+    bstr_xappend(arg, &arg->out_buf, (bstr){(unsigned char *)data, len});
+    if (arg->blocking && arg->out_buf.len >= MAX_QUEUED_OUTPUT)
+        return flush_output(arg, true);
+    return 0;
+}
+
+// Send as much of the queued output as possible. If block is set, wait until
+// everything was sent. Returns <0 on errors.
+static int flush_output(struct client_arg *arg, bool block)
+{
+    while (arg->out_pos < arg->out_buf.len) {
+        ssize_t rc = send(arg->client_fd, arg->out_buf.start + arg->out_pos,
+                          arg->out_buf.len - arg->out_pos, MSG_NOSIGNAL);
         if (rc <= 0) {
             if (rc == 0)
                 return -1;
 
             if (errno == EBADF || errno == ENOTSOCK) {
-                client->writable = false;
-                return 0;
+                arg->writable = false;
+                break;
             }
 
-            if (errno == EINTR || errno == EAGAIN)
+            if (errno == EINTR)
                 continue;
 
+            if (errno == EAGAIN) {
+                if (!block)
+                    return 0;
+                poll(&(struct pollfd){.events = POLLOUT, .fd = arg->client_fd},
+                     1, -1);
+                continue;
+            }
+
             return rc;
         }
 
-        count -= rc;
-        buf   += rc;
+        arg->out_pos += rc;
     }
 
+    arg->out_buf.len = 0;
+    arg->out_pos = 0;
     return 0;
 }
 
-static void *client_thread(void *p)
+static bool has_pending_output(struct client_arg *arg)
 {
-    pthread_detach(pthread_self());
-
-    // We don't use MSG_NOSIGNAL because the moldy fruit OS doesn't support it.
-    struct sigaction sa = { .sa_handler = SIG_IGN, .sa_flags = SA_RESTART };
-    sigfillset(&sa.sa_mask);
-    sigaction(SIGPIPE, &sa, NULL);
-
-    int rc;
-
-    struct client_arg *arg = p;
-    bstr client_msg = { talloc_strdup(NULL, ""), 0 };
-
-    mpthread_set_name(arg->client_name);
+    return arg->out_pos < arg->out_buf.len;
+}
 
-    int pipe_fd = mpv_get_wakeup_pipe(arg->client);
-    if (pipe_fd < 0) {
-        MP_ERR(arg, "Could not get wakeup pipe\n");
-        goto done;
-    }
+// Read all pending events and queue them for sending. Returns true if the
+// client should be closed.
+static bool process_events(struct client_arg *arg)
+{
+    mp_flush_wakeup_pipe(arg->wakeup_fd);
 
-    MP_VERBOSE(arg, "Client connected\n");
+    while (1) {
+        mpv_event *event = mpv_wait_event(arg->client, 0);
 
-    struct pollfd fds[2] = {
-        {.events = POLLIN, .fd = pipe_fd},
-        {.events = POLLIN, .fd = arg->client_fd},
-    };
+        if (event->event_id == MPV_EVENT_NONE)
+            break;
 
-    fcntl(arg->client_fd, F_SETFL, fcntl(arg->client_fd, F_GETFL, 0) | O_NONBLOCK);
+        if (event->event_id == MPV_EVENT_SHUTDOWN)
+            return true;
 
-    while (1) {
-        rc = poll(fds, 2, 0);
-        if (rc == 0)
-            rc = poll(fds, 2, -1);
-        if (rc < 0) {
-            MP_ERR(arg, "Poll error\n");
+        if (!arg->writable)
             continue;
+
+        if (mp_ipc_write_event(event, arg->protocol, queue_output, arg) < 0) {
+            MP_ERR(arg, "Encoding or write error\n");
+            return true;
         }
+    }
 
-        if (fds[0].revents & POLLIN) {
-            mp_flush_wakeup_pipe(pipe_fd);
+    return false;
+}
 
-            while (1) {
-                mpv_event *event = mpv_wait_event(arg->client, 0);
+// Read and run all commands received so far, and queue the replies. Returns
+// true if the client should be closed.
+static bool process_input(struct client_arg *arg)
+{
+    while (1) {
+        char buf[4096];
 
-                if (event->event_id == MPV_EVENT_NONE)
-                    break;
+        ssize_t bytes = read(arg->client_fd, buf, sizeof(buf));
+        if (bytes < 0) {
+            if (errno == EAGAIN)
+                break;
+            if (errno == EINTR)
+                continue;
 
-                if (event->event_id == MPV_EVENT_SHUTDOWN)
-                    goto done;
+            MP_ERR(arg, "Read error (%s)\n", mp_strerror(errno));
+            return true;
+        }
 
-                if (!arg->writable)
-                    continue;
+        if (bytes == 0) {
+            MP_VERBOSE(arg, "Client disconnected\n");
+            return true;
+        }
 
-                char *event_msg = mp_json_encode_event(event);
-                if (!event_msg) {
-                    MP_ERR(arg, "Encoding error\n");
-                    goto done;
-                }
+        bstr_xappend(arg, &arg->in_buf, (bstr){buf, bytes});
 
-                rc = ipc_write_str(arg, event_msg);
-                talloc_free(event_msg);
-                if (rc < 0) {
-                    MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
-                    goto done;
-                }
+        while (mp_ipc_has_next_message(arg->in_buf, arg->protocol)) {
+            if (mp_ipc_consume_next_message(arg->client, &arg->in_buf,
+                                            &arg->protocol, queue_output,
+                                            arg) < 0)
+            {
+                MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
+                return true;
             }
         }
+    }
 
-        if (fds[1].revents & (POLLIN | POLLHUP | POLLNVAL)) {
-            while (1) {
-                char buf[128];
-                bstr append = { buf, 0 };
-
-                ssize_t bytes = read(arg->client_fd, buf, sizeof(buf));
-                if (bytes < 0) {
-                    if (errno == EAGAIN)
-                        break;
-
-                    MP_ERR(arg, "Read error (%s)\n", mp_strerror(errno));
-                    goto done;
-                }
-
-                if (bytes == 0) {
-                    MP_VERBOSE(arg, "Client disconnected\n");
-                    goto done;
-                }
-
-                append.len = bytes;
-
-                bstr_xappend(NULL, &client_msg, append);
-
-                while (bstrchr(client_msg, '\n') != -1) {
-                    char *reply_msg = mp_ipc_consume_next_command(arg->client,
-                        NULL, &client_msg);
-
-                    if (reply_msg && arg->writable) {
-                        rc = ipc_write_str(arg, reply_msg);
-                        if (rc < 0) {
-                            MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
-                            talloc_free(reply_msg);
-                            goto done;
-                        }
-                    }
-
-                    talloc_free(reply_msg);
-                }
-            }
-        }
+    return false;
+}
+
+static bool client_init(struct client_arg *arg)
+{
+    arg->wakeup_fd = mpv_get_wakeup_pipe(arg->client);
+    if (arg->wakeup_fd < 0) {
+        MP_ERR(arg, "Could not get wakeup pipe\n");
+        return false;
     }
 
-done:
-    if (client_msg.len > 0)
+    MP_VERBOSE(arg, "Client connected\n");
+
+    fcntl(arg->client_fd, F_SETFL, fcntl(arg->client_fd, F_GETFL, 0) | O_NONBLOCK);
+    return true;
+}
+
+static void client_destroy(struct client_arg *arg)
+{
+    // Best effort attempt to send replies/events queued before closing.
+    flush_output(arg, false);
+    if (arg->in_buf.len > 0)
         MP_WARN(arg, "Ignoring unterminated command on disconnect.\n");
-    talloc_free(client_msg.start);
+    talloc_free(arg->in_buf.start);
     if (arg->close_client_fd)
         close(arg->client_fd);
     struct mpv_handle *h = arg->client;
@@ -219,6 +262,54 @@ done:
     } else {
         mpv_destroy(h);
     }
+}
+
+static void *client_thread(void *p)
+{
+    pthread_detach(pthread_self());
+
+    ignore_sigpipe();
+
+    struct client_arg *arg = p;
+    arg->blocking = true;
+
+    mpthread_set_name(arg->client_name);
+
+    if (!client_init(arg))
+        goto done;
+
+    struct pollfd fds[2] = {
+        {.events = POLLIN, .fd = arg->wakeup_fd},
+        {.events = POLLIN, .fd = arg->client_fd},
+    };
+
+    while (1) {
+        int rc = poll(fds, 2, 0);
+        if (rc == 0)
+            rc = poll(fds, 2, -1);
+        if (rc < 0) {
+            MP_ERR(arg, "Poll error\n");
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            if (process_events(arg))
+                goto done;
+        }
+
+        if (fds[1].revents & (POLLIN | POLLHUP | POLLNVAL)) {
+            if (process_input(arg))
+                goto done;
+        }
+
+        if (flush_output(arg, true) < 0) {
+            MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
+            goto done;
+        }
+    }
+
+done:
+    client_destroy(arg);
     return NULL;
 }
 
@@ -251,7 +342,7 @@ err:
     return false;
 }
 
-static void ipc_start_client_json(struct mp_ipc_ctx *ctx, int id, int fd)
+static struct client_arg *new_client_json(int id, int fd)
 {
     struct client_arg *client = talloc_ptrtype(NULL, client);
     *client = (struct client_arg){
@@ -262,8 +353,34 @@ static void ipc_start_client_json(struct mp_ipc_ctx *ctx, int id, int fd)
         .quit_on_close = id < 0,
         .writable = true,
     };
+    return client;
+}
+
+static void ipc_start_client_json(struct mp_ipc_ctx *ctx, int id, int fd)
+{
+    ipc_start_client(ctx, new_client_json(id, fd), true);
+}
+
+// Like ipc_start_client_json(), but for the multiplexed server: no thread is
+// created, and the client is added to the clients array instead.
+static void ipc_add_client_json(struct mp_ipc_ctx *ctx, int id, int fd,
+                                struct client_arg ***clients, int *num_clients)
+{
+    struct client_arg *client = new_client_json(id, fd);
+    client->client = mp_new_client(ctx->client_api, client->client_name);
+    if (!client->client) {
+        close(fd);
+        talloc_free(client);
+        return;
+    }
+    client->log = mp_client_get_log(client->client);
 
-    ipc_start_client(ctx, client, true);
+    if (!client_init(client)) {
+        client_destroy(client);
+        return;
+    }
+
+    MP_TARRAY_APPEND(ctx, *clients, *num_clients, client);
 }
 
 bool mp_ipc_start_anon_client(struct mp_ipc_ctx *ctx, struct mpv_handle *h,
@@ -304,6 +421,12 @@ static void *ipc_thread(void *p)
 
     struct mp_ipc_ctx *arg = p;
 
+    // With --input-ipc-server-multiplex, all clients are served by this thread,
+    // instead of creating a thread per client.
+    struct client_arg **clients = NULL;
+    int num_clients = 0;
+    struct pollfd *fds = NULL;
+
     mpthread_set_name("ipc socket listener");
 
     MP_VERBOSE(arg, "Starting IPC master\n");
@@ -349,13 +472,28 @@ static void *ipc_thread(void *p)
 
     int client_num = 0;
 
-    struct pollfd fds[2] = {
-        {.events = POLLIN, .fd = arg->death_pipe[0]},
-        {.events = POLLIN, .fd = ipc_fd},
-    };
+    if (arg->multiplex)
+        ignore_sigpipe();
 
     while (1) {
-        rc = poll(fds, 2, -1);
+        int num_fds = 2 + num_clients * 2;
+        MP_TARRAY_GROW(arg, fds, num_fds);
+
+        fds[0] = (struct pollfd){.events = POLLIN, .fd = arg->death_pipe[0]};
+        fds[1] = (struct pollfd){.events = POLLIN, .fd = ipc_fd};
+        for (int n = 0; n < num_clients; n++) {
+            struct client_arg *client = clients[n];
+            fds[2 + n * 2] = (struct pollfd){
+                .events = POLLIN,
+                .fd = client->wakeup_fd,
+            };
+            fds[3 + n * 2] = (struct pollfd){
+                .events = POLLIN | (has_pending_output(client) ? POLLOUT : 0),
+                .fd = client->client_fd,
+            };
+        }
+
+        rc = poll(fds, num_fds, -1);
         if (rc < 0) {
             MP_ERR(arg, "Poll error\n");
             continue;
@@ -364,6 +502,30 @@ static void *ipc_thread(void *p)
         if (fds[0].revents & POLLIN)
             goto done;
 
+        // Iterate backwards, so that removing a client does not change the
+        // fds[] indexes of clients which still need to be processed.
+        for (int n = num_clients - 1; n >= 0; n--) {
+            struct client_arg *client = clients[n];
+            bool close_client = false;
+
+            if (fds[2 + n * 2].revents & POLLIN)
+                close_client |= process_events(client);
+
+            if (fds[3 + n * 2].revents & (POLLIN | POLLHUP | POLLNVAL))
+                close_client |= process_input(client);
+
+            // All output produced in this iteration is sent with one call.
+            if (!close_client && flush_output(client, false) < 0) {
+                MP_ERR(client, "Write error (%s)\n", mp_strerror(errno));
+                close_client = true;
+            }
+
+            if (close_client) {
+                client_destroy(client);
+                MP_TARRAY_REMOVE_AT(clients, num_clients, n);
+            }
+        }
+
         if (fds[1].revents & POLLIN) {
             int client_fd = accept(ipc_fd, NULL, NULL);
             if (client_fd < 0) {
@@ -371,11 +533,21 @@ static void *ipc_thread(void *p)
                 goto done;
             }
 
-            ipc_start_client_json(arg, client_num++, client_fd);
+            if (arg->multiplex) {
+                ipc_add_client_json(arg, client_num++, client_fd,
+                                    &clients, &num_clients);
+            } else {
+                ipc_start_client_json(arg, client_num++, client_fd);
+            }
         }
     }
 
 done:
+    for (int n = 0; n < num_clients; n++)
+        client_destroy(clients[n]);
+    talloc_free(clients);
+    talloc_free(fds);
+
     if (ipc_fd >= 0)
         close(ipc_fd);
 
@@ -392,6 +564,7 @@ struct mp_ipc_ctx *mp_init_ipc(struct mp_client_api *client_api,
         .log        = mp_log_new(arg, global->log, "ipc"),
         .client_api = client_api,
         .path       = mp_get_user_path(arg, global, opts->ipc_path),
+        .multiplex  = opts->ipc_multiplex,
         .death_pipe = {-1, -1},
     };
 
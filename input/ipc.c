@@ -20,6 +20,7 @@
 #include "common/msg.h"
 #include "input/input.h"
 #include "misc/json.h"
+#include "misc/msgpack.h"
 #include "misc/node.h"
 #include "options/m_option.h"
 #include "options/options.h"
@@ -56,6 +57,18 @@ static void mpv_node_map_add(void *ta_parent, mpv_node *src, const char *key, mp
     src->u.list->num++;
 }
 
+static bool node_get_number(mpv_node *src, double *out)
+{
+    if (src->format == MPV_FORMAT_INT64) {
+        *out = src->u.int64;
+    } else if (src->format == MPV_FORMAT_DOUBLE) {
+        *out = src->u.double_;
+    } else {
+        return false;
+    }
+    return true;
+}
+
 static void mpv_node_map_add_null(void *ta_parent, mpv_node *src, const char *key)
 {
     mpv_node val_node = {.format = MPV_FORMAT_NONE};
@@ -89,19 +102,39 @@ static void mpv_format_command_reply(void *ta_parent, mpv_event *event,
     mpv_node_map_add(ta_parent, dst, "data", &cmd->result);
 }
 
-char *mp_json_encode_event(mpv_event *event)
+static void event_to_node(void *ta_parent, mpv_event *event, mpv_node *dst)
 {
-    void *ta_parent = talloc_new(NULL);
-
-    struct mpv_node event_node;
     if (event->event_id == MPV_EVENT_COMMAND_REPLY) {
-        event_node = (mpv_node){.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
-        mpv_format_command_reply(ta_parent, event, &event_node);
+        *dst = (mpv_node){.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+        mpv_format_command_reply(ta_parent, event, dst);
     } else {
-        mpv_event_to_node(&event_node, event);
+        mpv_event_to_node(dst, event);
         // Abuse mpv_event_to_node() internals.
-        talloc_steal(ta_parent, node_get_alloc(&event_node));
+        talloc_steal(ta_parent, node_get_alloc(dst));
     }
+}
+
+// Append a binary protocol frame containing src to *dst.
+static int write_frame(void *talloc_ctx, bstr *dst, mpv_node *src)
+{
+    size_t start = dst->len;
+    bstr_xappend(talloc_ctx, dst, (bstr){"\0\0\0\0", 4});
+    if (msgpack_write(talloc_ctx, dst, src) < 0)
+        return -1;
+    size_t len = dst->len - start - 4;
+    if (len > UINT32_MAX)
+        return -1;
+    for (int n = 0; n < 4; n++)
+        dst->start[start + n] = len >> ((3 - n) * 8);
+    return 0;
+}
+
+char *mp_json_encode_event(mpv_event *event)
+{
+    void *ta_parent = talloc_new(NULL);
+
+    struct mpv_node event_node;
+    event_to_node(ta_parent, event, &event_node);
 
     char *output = talloc_strdup(NULL, "");
     json_write(&output, &event_node);
@@ -112,35 +145,63 @@ char *mp_json_encode_event(mpv_event *event)
     return output;
 }
 
-// Function is allowed to modify src[n].
-static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
-                                  char *src)
+// Write src in the given protocol to the write callback.
+static int write_message(mpv_node *src, int protocol, mp_ipc_write_fn write,
+                         void *ctx)
+{
+    if (protocol == MP_IPC_JSON) {
+        if (json_write_cb(src, write, ctx) < 0)
+            return -1;
+        return write(ctx, "\n", 1);
+    }
+
+    bstr frame = {0};
+    int r = write_frame(NULL, &frame, src);
+    if (r >= 0)
+        r = write(ctx, frame.start, frame.len);
+    talloc_free(frame.start);
+    return r;
+}
+
+int mp_ipc_write_event(struct mpv_event *event, int protocol,
+                       mp_ipc_write_fn write, void *ctx)
+{
+    void *ta_parent = talloc_new(NULL);
+
+    struct mpv_node event_node;
+    event_to_node(ta_parent, event, &event_node);
+
+    int r = write_message(&event_node, protocol, write, ctx);
+
+    talloc_free(ta_parent);
+
+    return r;
+}
+
+// Run the command in msg_node (NULL if the message could not be parsed), and
+// write the reply to *reply_node. Returns false if no reply should be sent.
+// protocol is NULL if the connection does not support switching protocols.
+static bool execute_command(struct mpv_handle *client, void *ta_parent,
+                            mpv_node *msg_node, int *protocol,
+                            mpv_node *reply_node)
 {
-    int rc;
+    int rc = MPV_ERROR_INVALID_PARAMETER;
     const char *cmd = NULL;
     struct mp_log *log = mp_client_get_log(client);
 
-    mpv_node msg_node;
-    mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+    *reply_node = (mpv_node){.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
     mpv_node *reqid_node = NULL;
     int64_t reqid = 0;
     mpv_node *async_node = NULL;
     bool async = false;
     bool send_reply = true;
 
-    rc = json_parse(ta_parent, &msg_node, &src, 50);
-    if (rc < 0) {
-        mp_err(log, "malformed JSON received: '%s'\n", src);
+    if (!msg_node || msg_node->format != MPV_FORMAT_NODE_MAP) {
         rc = MPV_ERROR_INVALID_PARAMETER;
         goto error;
     }
 
-    if (msg_node.format != MPV_FORMAT_NODE_MAP) {
-        rc = MPV_ERROR_INVALID_PARAMETER;
-        goto error;
-    }
-
-    async_node = node_map_get(&msg_node, "async");
+    async_node = node_map_get(msg_node, "async");
     if (async_node) {
         if (async_node->format != MPV_FORMAT_FLAG) {
             rc = MPV_ERROR_INVALID_PARAMETER;
@@ -149,7 +210,7 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         async = async_node->u.flag;
     }
 
-    reqid_node = node_map_get(&msg_node, "request_id");
+    reqid_node = node_map_get(msg_node, "request_id");
     if (reqid_node) {
         if (reqid_node->format == MPV_FORMAT_INT64) {
             reqid = reqid_node->u.int64;
@@ -163,7 +224,7 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         }
     }
 
-    mpv_node *cmd_node = node_map_get(&msg_node, "command");
+    mpv_node *cmd_node = node_map_get(msg_node, "command");
     if (!cmd_node) {
         rc = MPV_ERROR_INVALID_PARAMETER;
         goto error;
@@ -181,15 +242,42 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
 
     if (cmd && !strcmp("client_name", cmd)) {
         const char *client_name = mpv_client_name(client);
-        mpv_node_map_add_string(ta_parent, &reply_node, "data", client_name);
+        mpv_node_map_add_string(ta_parent, reply_node, "data", client_name);
         rc = MPV_ERROR_SUCCESS;
+    } else if (cmd && !strcmp("set_protocol", cmd)) {
+        if (cmd_node->u.list->num != 2) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        if (cmd_node->u.list->values[1].format != MPV_FORMAT_STRING) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        char *name = cmd_node->u.list->values[1].u.string;
+        int new_protocol = -1;
+        if (strcmp(name, "json") == 0) {
+            new_protocol = MP_IPC_JSON;
+        } else if (strcmp(name, "msgpack") == 0) {
+            new_protocol = MP_IPC_MSGPACK;
+        }
+
+        if (new_protocol < 0) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+        } else if (!protocol) {
+            rc = MPV_ERROR_NOT_IMPLEMENTED;
+        } else {
+            *protocol = new_protocol;
+            rc = MPV_ERROR_SUCCESS;
+        }
     } else if (cmd && !strcmp("get_time_us", cmd)) {
         int64_t time_us = mpv_get_time_us(client);
-        mpv_node_map_add_int64(ta_parent, &reply_node, "data", time_us);
+        mpv_node_map_add_int64(ta_parent, reply_node, "data", time_us);
         rc = MPV_ERROR_SUCCESS;
     } else if (cmd && !strcmp("get_version", cmd)) {
         int64_t ver = mpv_client_api_version();
-        mpv_node_map_add_int64(ta_parent, &reply_node, "data", ver);
+        mpv_node_map_add_int64(ta_parent, reply_node, "data", ver);
         rc = MPV_ERROR_SUCCESS;
     } else if (cmd && !strcmp("get_property", cmd)) {
         mpv_node result_node;
@@ -207,7 +295,7 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         rc = mpv_get_property(client, cmd_node->u.list->values[1].u.string,
                               MPV_FORMAT_NODE, &result_node);
         if (rc >= 0) {
-            mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
+            mpv_node_map_add(ta_parent, reply_node, "data", &result_node);
             mpv_free_node_contents(&result_node);
         }
     } else if (cmd && !strcmp("get_property_string", cmd)) {
@@ -224,10 +312,10 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         char *result = mpv_get_property_string(client,
                                         cmd_node->u.list->values[1].u.string);
         if (result) {
-            mpv_node_map_add_string(ta_parent, &reply_node, "data", result);
+            mpv_node_map_add_string(ta_parent, reply_node, "data", result);
             mpv_free(result);
         } else {
-            mpv_node_map_add_null(ta_parent, &reply_node, "data");
+            mpv_node_map_add_null(ta_parent, reply_node, "data");
         }
     } else if (cmd && (!strcmp("set_property", cmd) ||
                        !strcmp("set_property_string", cmd)))
@@ -244,46 +332,40 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
 
         rc = mpv_set_property(client, cmd_node->u.list->values[1].u.string,
                               MPV_FORMAT_NODE, &cmd_node->u.list->values[2]);
-    } else if (cmd && !strcmp("observe_property", cmd)) {
-        if (cmd_node->u.list->num != 3) {
-            rc = MPV_ERROR_INVALID_PARAMETER;
-            goto error;
-        }
-
-        if (cmd_node->u.list->values[1].format != MPV_FORMAT_INT64) {
-            rc = MPV_ERROR_INVALID_PARAMETER;
-            goto error;
-        }
-
-        if (cmd_node->u.list->values[2].format != MPV_FORMAT_STRING) {
+    } else if (cmd && (!strcmp("observe_property", cmd) ||
+                       !strcmp("observe_property_string", cmd)))
+    {
+        mpv_node_list *args = cmd_node->u.list;
+        if (args->num < 3 || args->num > 5) {
             rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
         }
 
-        rc = mpv_observe_property(client,
-                                  cmd_node->u.list->values[1].u.int64,
-                                  cmd_node->u.list->values[2].u.string,
-                                  MPV_FORMAT_NODE);
-    } else if (cmd && !strcmp("observe_property_string", cmd)) {
-        if (cmd_node->u.list->num != 3) {
+        if (args->values[1].format != MPV_FORMAT_INT64) {
             rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
         }
 
-        if (cmd_node->u.list->values[1].format != MPV_FORMAT_INT64) {
+        if (args->values[2].format != MPV_FORMAT_STRING) {
             rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
         }
 
-        if (cmd_node->u.list->values[2].format != MPV_FORMAT_STRING) {
-            rc = MPV_ERROR_INVALID_PARAMETER;
-            goto error;
+        // Optional rate limiting parameters.
+        double limits[2] = {0};
+        for (int n = 3; n < args->num; n++) {
+            if (!node_get_number(&args->values[n], &limits[n - 3])) {
+                rc = MPV_ERROR_INVALID_PARAMETER;
+                goto error;
+            }
         }
 
-        rc = mpv_observe_property(client,
-                                  cmd_node->u.list->values[1].u.int64,
-                                  cmd_node->u.list->values[2].u.string,
-                                  MPV_FORMAT_STRING);
+        bool str = !strcmp("observe_property_string", cmd);
+        rc = mpv_observe_property_ex(client,
+                                     args->values[1].u.int64,
+                                     args->values[2].u.string,
+                                     str ? MPV_FORMAT_STRING : MPV_FORMAT_NODE,
+                                     limits[0], limits[1]);
     } else if (cmd && !strcmp("unobserve_property", cmd)) {
         if (cmd_node->u.list->num != 2) {
             rc = MPV_ERROR_INVALID_PARAMETER;
@@ -343,6 +425,21 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
             }
             rc = mpv_request_event(client, event, enable);
         }
+    } else if (cmd && !strcmp("batch", cmd)) {
+        if (cmd_node->u.list->num != 2) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        mpv_node result_node;
+        rc = mpv_command_batch(client, &cmd_node->u.list->values[1],
+                               &result_node);
+        if (result_node.format == MPV_FORMAT_NODE_ARRAY) {
+            // Use error strings, as in the reply itself.
+            mp_command_batch_error_strings(&result_node);
+            mpv_node_map_add(ta_parent, reply_node, "data", &result_node);
+            mpv_free_node_contents(&result_node);
+        }
     } else {
         mpv_node result_node = {0};
 
@@ -353,7 +450,7 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         } else {
             rc = mpv_command_node(client, cmd_node, &result_node);
             if (rc >= 0)
-                mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
+                mpv_node_map_add(ta_parent, reply_node, "data", &result_node);
         }
 
         mpv_free_node_contents(&result_node);
@@ -365,16 +462,33 @@ error:
      * the original requests.
      */
     if (reqid_node) {
-        mpv_node_map_add(ta_parent, &reply_node, "request_id", reqid_node);
+        mpv_node_map_add(ta_parent, reply_node, "request_id", reqid_node);
     } else {
-        mpv_node_map_add_int64(ta_parent, &reply_node, "request_id", 0);
+        mpv_node_map_add_int64(ta_parent, reply_node, "request_id", 0);
     }
 
-    mpv_node_map_add_string(ta_parent, &reply_node, "error", mpv_error_string(rc));
+    mpv_node_map_add_string(ta_parent, reply_node, "error", mpv_error_string(rc));
+
+    return send_reply;
+}
 
+// Function is allowed to modify src[n].
+static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
+                                  char *src, int *protocol)
+{
+    struct mp_log *log = mp_client_get_log(client);
+
+    mpv_node msg_node;
+    bool ok = json_parse(ta_parent, &msg_node, &src, 50) >= 0;
+    if (!ok)
+        mp_err(log, "malformed JSON received: '%s'\n", src);
+
+    mpv_node reply_node;
     char *output = talloc_strdup(ta_parent, "");
 
-    if (send_reply) {
+    if (execute_command(client, ta_parent, ok ? &msg_node : NULL, protocol,
+                        &reply_node))
+    {
         json_write(&output, &reply_node);
         output = ta_talloc_strdup_append(output, "\n");
     }
@@ -389,7 +503,8 @@ static char *text_execute_command(struct mpv_handle *client, void *tmp, char *sr
     return NULL;
 }
 
-char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf)
+static char *consume_next_line(struct mpv_handle *client, void *ctx, bstr *buf,
+                               int *protocol)
 {
     void *tmp = talloc_new(NULL);
 
@@ -405,7 +520,7 @@ char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *bu
     if (line0[0] == '\0' || line0[0] == '#') {
         // skip
     } else if (line0[0] == '{') {
-        reply_msg = json_execute_command(client, tmp, line0);
+        reply_msg = json_execute_command(client, tmp, line0, protocol);
     } else {
         reply_msg = text_execute_command(client, tmp, line0);
     }
@@ -414,3 +529,84 @@ char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *bu
     talloc_free(tmp);
     return reply_msg;
 }
+
+char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf)
+{
+    return consume_next_line(client, ctx, buf, NULL);
+}
+
+// Return the size of the first binary frame in buf (including the length
+// prefix), or 0 if it is incomplete.
+static size_t get_frame_size(bstr buf)
+{
+    if (buf.len < 4)
+        return 0;
+    uint32_t len = ((uint32_t)buf.start[0] << 24) | (buf.start[1] << 16) |
+                   (buf.start[2] << 8) | buf.start[3];
+    return buf.len - 4 >= len ? 4 + (size_t)len : 0;
+}
+
+bool mp_ipc_has_next_message(bstr buf, int protocol)
+{
+    if (protocol == MP_IPC_JSON)
+        return bstrchr(buf, '\n') != -1;
+    return get_frame_size(buf) > 0;
+}
+
+int mp_ipc_consume_next_message(struct mpv_handle *client, bstr *buf,
+                                int *protocol, mp_ipc_write_fn write,
+                                void *ctx)
+{
+    // The parsed message and the reply are many small allocations that are
+    // all freed at the end.
+    void *tmp = talloc_new_arena(NULL);
+    mpv_node msg_node;
+    bool ok;
+
+    if (*protocol == MP_IPC_JSON) {
+        bstr rest;
+        bstr line = bstr_getline(*buf, &rest);
+        char *line0 = bstrto0(tmp, line);
+        talloc_steal(tmp, buf->start);
+        *buf = bstrdup(NULL, rest);
+
+        json_skip_whitespace(&line0);
+
+        if (line0[0] != '{') {
+            // Empty lines and comments are skipped. Text commands have no
+            // reply.
+            if (line0[0] && line0[0] != '#')
+                text_execute_command(client, tmp, line0);
+            talloc_free(tmp);
+            return 0;
+        }
+
+        ok = json_parse(tmp, &msg_node, &line0, 50) >= 0;
+        if (!ok)
+            mp_err(mp_client_get_log(client), "malformed JSON received: '%s'\n",
+                   line0);
+    } else {
+        size_t size = get_frame_size(*buf);
+        assert(size);
+        bstr frame = bstr_splice(*buf, 4, size);
+        talloc_steal(tmp, buf->start);
+        *buf = bstrdup(NULL, bstr_cut(*buf, size));
+
+        ok = msgpack_parse(tmp, &msg_node, &frame, 50) >= 0 && !frame.len;
+        if (!ok) {
+            mp_err(mp_client_get_log(client),
+                   "malformed binary message received\n");
+        }
+    }
+
+    // The reply uses the protocol the command was received with.
+    int reply_protocol = *protocol;
+    int r = 0;
+    mpv_node reply_node;
+    if (execute_command(client, tmp, ok ? &msg_node : NULL, protocol,
+                        &reply_node))
+        r = write_message(&reply_node, reply_protocol, write, ctx);
+
+    talloc_free(tmp);
+    return r;
+}
@@ -240,7 +240,7 @@ extern "C" {
  * relational operators (<, >, <=, >=).
  */
 #define MPV_MAKE_VERSION(major, minor) (((major) << 16) | (minor) | 0UL)
-#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(2, 0)
+#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(2, 2)
 
 /**
  * The API user is allowed to "#define MPV_ENABLE_DEPRECATED 0" before
@@ -946,6 +946,43 @@ MPV_EXPORT int mpv_command_node(mpv_handle *ctx, mpv_node *args, mpv_node *resul
  */
 MPV_EXPORT int mpv_command_ret(mpv_handle *ctx, const char **args, mpv_node *result);
 
+/**
+ * Run a list of commands and property writes in order, as a single request to
+ * the playback core. Unlike calling mpv_command_node() and mpv_set_property()
+ * in a loop, the core is woken up and locked only once for the whole list,
+ * and nothing else (such as the playback loop or other clients) runs between
+ * the entries. The only exception are commands which complete on another
+ * thread (such as "sub-add" and "screenshot-to-file"), which are waited
+ * for without blocking the core. Entries are not rolled back if a later entry
+ * fails; every entry is run regardless of the result of previous entries.
+ *
+ * Does not use OSD and string expansion by default.
+ *
+ * The args argument must have the format MPV_FORMAT_NODE_ARRAY. Each entry
+ * is one of:
+ *
+ * MPV_FORMAT_NODE_MAP with a "property" entry:
+ *      Set the property named by the "property" entry (MPV_FORMAT_STRING) to
+ *      the value of the "value" entry, like mpv_set_property() with
+ *      MPV_FORMAT_NODE.
+ *
+ * Anything else:
+ *      A command, using the same format as the args parameter of
+ *      mpv_command_node().
+ *
+ * @param[in] args list of entries as documented above
+ * @param[out] result Optional, pass NULL if unused. If not NULL, this is set
+ *                    to a MPV_FORMAT_NODE_ARRAY with one MPV_FORMAT_NODE_MAP
+ *                    per entry, in order. Each map has an "error" entry
+ *                    (MPV_FORMAT_INT64, an mpv_error value), and for commands
+ *                    that return data, a "data" entry. You must call
+ *                    mpv_free_node_contents() to free it. If the list could
+ *                    not be run at all, this is set to MPV_FORMAT_NONE.
+ * @return 0 if all entries succeeded, the error code of the first entry that
+ *         failed otherwise, or an error code if the list could not be run
+ */
+MPV_EXPORT int mpv_command_batch(mpv_handle *ctx, mpv_node *args, mpv_node *result);
+
 /**
  * Same as mpv_command, but use input.conf parsing for splitting arguments.
  * This is slightly simpler, but also more error prone, since arguments may
@@ -1204,6 +1241,36 @@ MPV_EXPORT int mpv_get_property_async(mpv_handle *ctx, uint64_t reply_userdata,
 MPV_EXPORT int mpv_observe_property(mpv_handle *mpv, uint64_t reply_userdata,
                                     const char *name, mpv_format format);
 
+/**
+ * Like mpv_observe_property(), but limit how often change events are sent.
+ * This is meant for properties which change very frequently (such as
+ * "time-pos" or "demuxer-cache-state"), where the client does not need every
+ * single update.
+ *
+ * Updates are coalesced before the property is read, so suppressed updates
+ * don't cost anything. With min_interval, change events are only delayed:
+ * the most recent value is always delivered eventually. With min_delta,
+ * changes smaller than the threshold are dropped, and not delivered until
+ * the value moves by at least min_delta from the last reported value.
+ *
+ * Safe to be called from mpv render API threads.
+ *
+ * @param reply_userdata see mpv_observe_property()
+ * @param name The property name.
+ * @param format see mpv_observe_property()
+ * @param min_interval Minimum time in seconds between two change events for
+ *                     this property. 0 disables rate limiting.
+ * @param min_delta If the property value is numeric (MPV_FORMAT_INT64,
+ *                  MPV_FORMAT_DOUBLE, or a MPV_FORMAT_NODE containing one of
+ *                  these), changes smaller than this value compared to the
+ *                  last reported value are not reported. 0 disables this.
+ * @return error code (MPV_ERROR_INVALID_PARAMETER if min_interval or
+ *         min_delta are negative)
+ */
+MPV_EXPORT int mpv_observe_property_ex(mpv_handle *mpv, uint64_t reply_userdata,
+                                       const char *name, mpv_format format,
+                                       double min_interval, double min_delta);
+
 /**
  * Undo mpv_observe_property(). This will remove all observed properties for
  * which the given number was passed as reply_userdata to mpv_observe_property.
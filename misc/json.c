@@ -41,6 +41,8 @@
  * invalid UTF-8 sequences to replacement characters.
  */
 
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -54,6 +56,39 @@
 
 #include "json.h"
 
+// Parser state. Items of arrays/objects which are being parsed are collected
+// on a shared stack, so the final arrays can be allocated with the exact size.
+struct parser {
+    void *ta_parent;
+    struct mpv_node *stack;
+    char **stack_keys;
+    int num_stack, alloc_stack;
+    // Initial stack; enough for typical IPC commands.
+    struct mpv_node stack_buf[32];
+    char *stack_keys_buf[32];
+};
+
+static void push_item(struct parser *p, struct mpv_node *value, char *key)
+{
+    if (p->num_stack == p->alloc_stack) {
+        int alloc = p->alloc_stack * 2;
+        if (p->stack == p->stack_buf) {
+            p->stack = talloc_memdup(NULL, p->stack_buf, sizeof(p->stack_buf));
+            p->stack_keys = talloc_memdup(NULL, p->stack_keys_buf,
+                                          sizeof(p->stack_keys_buf));
+        }
+        MP_RESIZE_ARRAY(NULL, p->stack, alloc);
+        MP_RESIZE_ARRAY(NULL, p->stack_keys, alloc);
+        p->alloc_stack = alloc;
+    }
+    p->stack[p->num_stack] = *value;
+    p->stack_keys[p->num_stack] = key;
+    p->num_stack++;
+}
+
+static int parse_value(struct parser *p, struct mpv_node *dst, char **src,
+                       int max_depth);
+
 static bool eat_c(char **s, char c)
 {
     if (**s == c) {
@@ -103,14 +138,14 @@ static int read_str(void *ta_parent, struct mpv_node *dst, char **src)
     char *str = *src;
     char *cur = str;
     bool has_escapes = false;
-    while (cur[0] && cur[0] != '"') {
-        if (cur[0] == '\\') {
-            has_escapes = true;
-            // skip >\"< and >\\< (latter to handle >\\"< correctly)
-            if (cur[1] == '"' || cur[1] == '\\')
-                cur++;
-        }
-        cur++;
+    while (1) {
+        // strcspn() is usually vectorized, and much faster than a byte loop.
+        cur += strcspn(cur, "\"\\");
+        if (cur[0] != '\\')
+            break;
+        has_escapes = true;
+        // skip the escaped character (handles >\"< and >\\"< correctly)
+        cur += cur[1] ? 2 : 1;
     }
     if (cur[0] != '"')
         return -1; // invalid termination
@@ -130,7 +165,7 @@ static int read_str(void *ta_parent, struct mpv_node *dst, char **src)
     return 0;
 }
 
-static int read_sub(void *ta_parent, struct mpv_node *dst, char **src,
+static int read_sub(struct parser *p, struct mpv_node *dst, char **src,
                     int max_depth)
 {
     bool is_arr = eat_c(src, '[');
@@ -138,41 +173,78 @@ static int read_sub(void *ta_parent, struct mpv_node *dst, char **src,
     if (!is_arr && !is_obj)
         return -1; // not an array or object
     char term = is_obj ? '}' : ']';
-    struct mpv_node_list *list = talloc_zero(ta_parent, struct mpv_node_list);
+    int base = p->num_stack;
     while (1) {
         eat_ws(src);
         if (eat_c(src, term))
             break;
-        if (list->num > 0 && !eat_c(src, ','))
+        if (p->num_stack > base && !eat_c(src, ','))
             return -1; // missing ','
         eat_ws(src);
         // non-standard extension: allow a trailing ","
         if (eat_c(src, term))
             break;
+        struct mpv_node keynode = {0};
         if (is_obj) {
-            struct mpv_node keynode;
             // non-standard extension: allow unquoted strings as keys
-            if (read_id(list, &keynode, src) < 0 &&
-                read_str(list, &keynode, src) < 0)
+            if (read_id(p->ta_parent, &keynode, src) < 0 &&
+                read_str(p->ta_parent, &keynode, src) < 0)
                 return -1; // key is not a string
             eat_ws(src);
             // non-standard extension: allow "=" instead of ":"
             if (!eat_c(src, ':') && !eat_c(src, '='))
                 return -1; // ':' missing
             eat_ws(src);
-            MP_TARRAY_GROW(list, list->keys, list->num);
-            list->keys[list->num] = keynode.u.string;
         }
-        MP_TARRAY_GROW(list, list->values, list->num);
-        if (json_parse(ta_parent, &list->values[list->num], src, max_depth) < 0)
+        struct mpv_node value;
+        if (parse_value(p, &value, src, max_depth) < 0)
             return -1;
-        list->num++;
+        push_item(p, &value, keynode.u.string);
     }
+    int num = p->num_stack - base;
+    struct mpv_node_list *list = talloc_zero(p->ta_parent, struct mpv_node_list);
+    if (num) {
+        list->values = talloc_memdup(list, &p->stack[base],
+                                     num * sizeof(list->values[0]));
+        if (is_obj) {
+            list->keys = talloc_memdup(list, &p->stack_keys[base],
+                                       num * sizeof(list->keys[0]));
+        }
+    }
+    list->num = num;
+    p->num_stack = base;
     dst->format = is_obj ? MPV_FORMAT_NODE_MAP : MPV_FORMAT_NODE_ARRAY;
     dst->u.list = list;
     return 0;
 }
 
+// Fast path for plain decimal integers, which are the most common numbers.
+// Returns false if the number needs the generic (strtoll/strtod) parser.
+static bool read_int(struct mpv_node *dst, char **src)
+{
+    char *cur = *src;
+    bool neg = eat_c(&cur, '-');
+    // Leading 0s would be parsed as octal by strtoll() in the generic path.
+    if (cur[0] < '1' || cur[0] > '9')
+        return false;
+    uint64_t v = 0;
+    int digits = 0;
+    while (cur[0] >= '0' && cur[0] <= '9') {
+        if (++digits > 18)
+            return false; // might overflow
+        v = v * 10 + (cur[0] - '0');
+        cur++;
+    }
+    // Fractions, exponents, hex floats etc.
+    if (cur[0] == '.' || cur[0] == 'e' || cur[0] == 'E' || cur[0] == 'x' ||
+        cur[0] == 'X' || cur[0] == 'p' || cur[0] == 'P')
+        return false;
+    *src = cur;
+    dst->format = MPV_FORMAT_INT64;
+    dst->u.int64 = neg ? -(int64_t)v : (int64_t)v;
+    return true;
+}
+
 /* Parse the string in *src as JSON, and write the result into *dst.
  * max_depth limits the recursion and JSON tree depth.
  * Warning: this overwrites the input string (what *src points to)!
@@ -186,6 +258,23 @@ static int read_sub(void *ta_parent, struct mpv_node *dst, char **src,
  */
 int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth)
 {
+    struct parser p = {.ta_parent = ta_parent};
+    p.stack = p.stack_buf;
+    p.stack_keys = p.stack_keys_buf;
+    p.alloc_stack = MP_ARRAY_SIZE(p.stack_buf);
+    int r = parse_value(&p, dst, src, max_depth);
+    if (p.stack != p.stack_buf) {
+        talloc_free(p.stack);
+        talloc_free(p.stack_keys);
+    }
+    return r;
+}
+
+static int parse_value(struct parser *p, struct mpv_node *dst, char **src,
+                       int max_depth)
+{
+    void *ta_parent = p->ta_parent;
+
     max_depth -= 1;
     if (max_depth < 0)
         return -1;
@@ -212,8 +301,10 @@ int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth)
     } else if (c == '"') {
         return read_str(ta_parent, dst, src);
     } else if (c == '[' || c == '{') {
-        return read_sub(ta_parent, dst, src, max_depth);
+        return read_sub(p, dst, src, max_depth);
     } else if (c == '-' || (c >= '0' && c <= '9')) {
+        if (read_int(dst, src))
+            return 0;
         // The number could be either a float or an int. JSON doesn't make a
         // difference, but the client API does.
         char *nsrci = *src, *nsrcf = *src;
@@ -243,7 +334,59 @@ int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth)
 }
 
 
-#define APPEND(b, s) bstr_xappend(NULL, (b), bstr0(s))
+// Output is collected in a fixed size buffer, which is passed to the write
+// callback whenever it is full (and at the end).
+struct json_out {
+    int (*write)(void *ctx, const char *data, size_t len);
+    void *ctx;
+    int error;
+    size_t len;
+    char buf[4096];
+};
+
+static void out_flush(struct json_out *out)
+{
+    if (out->len && !out->error && out->write(out->ctx, out->buf, out->len) < 0)
+        out->error = -1;
+    out->len = 0;
+}
+
+static void out_append(struct json_out *out, const char *data, size_t len)
+{
+    while (len && !out->error) {
+        if (out->len == sizeof(out->buf))
+            out_flush(out);
+        size_t copy = MPMIN(len, sizeof(out->buf) - out->len);
+        memcpy(out->buf + out->len, data, copy);
+        out->len += copy;
+        data += copy;
+        len -= copy;
+    }
+}
+
+#define APPEND(out, s) out_append((out), (s), strlen(s))
+
+static void out_printf(struct json_out *out, const char *fmt, ...)
+    PRINTF_ATTRIBUTE(2, 3);
+
+static void out_printf(struct json_out *out, const char *fmt, ...)
+{
+    char tmp[80];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (len < sizeof(tmp)) {
+        out_append(out, tmp, MPMAX(len, 0));
+    } else {
+        // Very large doubles with %f.
+        va_start(ap, fmt);
+        char *s = talloc_vasprintf(NULL, fmt, ap);
+        va_end(ap);
+        APPEND(out, s);
+        talloc_free(s);
+    }
+}
 
 static const char special_escape[] = {
     ['\b'] = 'b',
@@ -253,88 +396,150 @@ static const char special_escape[] = {
     ['\t'] = 't',
 };
 
-static void write_json_str(bstr *b, unsigned char *str)
+static bool needs_escape(unsigned char c)
 {
-    APPEND(b, "\"");
-    while (1) {
-        unsigned char *cur = str;
-        while (cur[0] >= 32 && cur[0] != '"' && cur[0] != '\\')
-            cur++;
-        if (!cur[0])
+    return c < 32 || c == '"' || c == '\\';
+}
+
+// Return the number of bytes at the start of str[0..len] which can be copied
+// to the output as they are. Checks 8 bytes at a time, which is a lot faster
+// for typical (mostly ASCII) strings.
+static size_t plain_run(const unsigned char *str, size_t len)
+{
+    const uint64_t ones = UINT64_C(0x0101010101010101);
+    const uint64_t high = UINT64_C(0x8080808080808080);
+    size_t n = 0;
+    while (len - n >= 8) {
+        uint64_t v;
+        memcpy(&v, str + n, 8);
+        uint64_t q = v ^ (ones * '"');
+        uint64_t b = v ^ (ones * '\\');
+        // Nonzero if any byte is < 32, '"' or '\\'. Bytes >= 0x80 can cause
+        // false positives, so check the bytes individually in this case.
+        uint64_t t = ((v - ones * 32) | (q - ones) | (b - ones)) & high;
+        if (t) {
+            for (int i = 0; i < 8; i++) {
+                if (needs_escape(str[n + i]))
+                    return n + i;
+            }
+        }
+        n += 8;
+    }
+    while (n < len && !needs_escape(str[n]))
+        n++;
+    return n;
+}
+
+static void write_json_str(struct json_out *out, const char *s)
+{
+    const unsigned char *str = s;
+    size_t len = strlen(s);
+    APPEND(out, "\"");
+    while (len) {
+        size_t run = plain_run(str, len);
+        out_append(out, str, run);
+        str += run;
+        len -= run;
+        if (!len)
             break;
-        bstr_xappend(NULL, b, (bstr){str, cur - str});
-        if (cur[0] == '\"') {
-            bstr_xappend(NULL, b, (bstr){"\\\"", 2});
-        } else if (cur[0] == '\\') {
-            bstr_xappend(NULL, b, (bstr){"\\\\", 2});
-        } else if (cur[0] < sizeof(special_escape) && special_escape[cur[0]]) {
-            bstr_xappend_asprintf(NULL, b, "\\%c", special_escape[cur[0]]);
+        unsigned char c = str[0];
+        if (c == '\"') {
+            APPEND(out, "\\\"");
+        } else if (c == '\\') {
+            APPEND(out, "\\\\");
+        } else if (c < sizeof(special_escape) && special_escape[c]) {
+            out_printf(out, "\\%c", special_escape[c]);
         } else {
-            bstr_xappend_asprintf(NULL, b, "\\u%04x", (unsigned char)cur[0]);
+            out_printf(out, "\\u%04x", c);
         }
-        str = cur + 1;
+        str += 1;
+        len -= 1;
     }
-    APPEND(b, str);
-    APPEND(b, "\"");
+    APPEND(out, "\"");
 }
 
-static void add_indent(bstr *b, int indent)
+static void add_indent(struct json_out *out, int indent)
 {
     if (indent < 0)
         return;
-    bstr_xappend(NULL, b, bstr0("\n"));
+    APPEND(out, "\n");
     for (int n = 0; n < indent; n++)
-        bstr_xappend(NULL, b, bstr0(" "));
+        APPEND(out, " ");
 }
 
-static int json_append(bstr *b, const struct mpv_node *src, int indent)
+static int json_append(struct json_out *out, const struct mpv_node *src,
+                       int indent)
 {
     switch (src->format) {
     case MPV_FORMAT_NONE:
-        APPEND(b, "null");
+        APPEND(out, "null");
         return 0;
     case MPV_FORMAT_FLAG:
-        APPEND(b, src->u.flag ? "true" : "false");
+        APPEND(out, src->u.flag ? "true" : "false");
         return 0;
     case MPV_FORMAT_INT64:
-        bstr_xappend_asprintf(NULL, b, "%"PRId64, src->u.int64);
+        out_printf(out, "%"PRId64, src->u.int64);
         return 0;
     case MPV_FORMAT_DOUBLE: {
         const char *px = isfinite(src->u.double_) ? "" : "\"";
-        bstr_xappend_asprintf(NULL, b, "%s%f%s", px, src->u.double_, px);
+        out_printf(out, "%s%f%s", px, src->u.double_, px);
         return 0;
     }
     case MPV_FORMAT_STRING:
-        write_json_str(b, src->u.string);
+        write_json_str(out, src->u.string);
         return 0;
     case MPV_FORMAT_NODE_ARRAY:
     case MPV_FORMAT_NODE_MAP: {
         struct mpv_node_list *list = src->u.list;
         bool is_obj = src->format == MPV_FORMAT_NODE_MAP;
-        APPEND(b, is_obj ? "{" : "[");
+        APPEND(out, is_obj ? "{" : "[");
         int next_indent = indent >= 0 ? indent + 1 : -1;
-        for (int n = 0; n < list->num; n++) {
+        // Stop early if the write callback failed (e.g. output limit reached).
+        for (int n = 0; n < list->num && !out->error; n++) {
             if (n)
-                APPEND(b, ",");
-            add_indent(b, next_indent);
+                APPEND(out, ",");
+            add_indent(out, next_indent);
             if (is_obj) {
-                write_json_str(b, list->keys[n]);
-                APPEND(b, ":");
+                write_json_str(out, list->keys[n]);
+                APPEND(out, ":");
             }
-            json_append(b, &list->values[n], next_indent);
+            json_append(out, &list->values[n], next_indent);
         }
-        add_indent(b, indent);
-        APPEND(b, is_obj ? "}" : "]");
+        add_indent(out, indent);
+        APPEND(out, is_obj ? "}" : "]");
         return 0;
     }
     }
     return -1; // unknown format
 }
 
+static int json_append_cb(struct mpv_node *src, int indent,
+                          int (*write)(void *ctx, const char *data, size_t len),
+                          void *ctx)
+{
+    struct json_out *out = talloc_ptrtype(NULL, out);
+    out->write = write;
+    out->ctx = ctx;
+    out->error = 0;
+    out->len = 0;
+    int r = json_append(out, src, indent);
+    out_flush(out);
+    if (out->error < 0)
+        r = -1;
+    talloc_free(out);
+    return r;
+}
+
+static int append_bstr(void *ctx, const char *data, size_t len)
+{
+    bstr_xappend(NULL, ctx, (bstr){(unsigned char *)data, len});
+    return 0;
+}
+
 static int json_append_str(char **dst, struct mpv_node *src, int indent)
 {
     bstr buffer = bstr0(*dst);
-    int r = json_append(&buffer, src, indent);
+    int r = json_append_cb(src, indent, append_bstr, &buffer);
     *dst = buffer.start;
     return r;
 }
@@ -354,3 +559,15 @@ int json_write_pretty(char **dst, struct mpv_node *src)
 {
     return json_append_str(dst, src, 0);
 }
+
+/* Write the contents of *src as JSON, and pass the output in chunks to the
+ * write callback, without building the complete string in memory. If write
+ * returns <0, no further data is written.
+ * Returns: 0 on success, <0 on failure (including write callback failures).
+ */
+int json_write_cb(struct mpv_node *src,
+                  int (*write)(void *ctx, const char *data, size_t len),
+                  void *ctx)
+{
+    return json_append_cb(src, -1, write, ctx);
+}
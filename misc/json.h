@@ -18,6 +18,8 @@
 #ifndef MP_JSON_H
 #define MP_JSON_H
 
+#include <stddef.h>
+
 // We reuse mpv_node.
 #include "libmpv/client.h"
 
@@ -25,5 +27,8 @@ int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth)
 void json_skip_whitespace(char **src);
 int json_write(char **s, struct mpv_node *src);
 int json_write_pretty(char **s, struct mpv_node *src);
+int json_write_cb(struct mpv_node *src,
+                  int (*write)(void *ctx, const char *data, size_t len),
+                  void *ctx);
 
 #endif
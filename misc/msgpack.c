@@ -0,0 +1,347 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* MessagePack parser and writer for mpv_node.
+ *
+ * Only the subset needed to represent mpv_node is supported:
+ *  - nil, bool, integers, float32/float64, str, bin, array, map
+ *  - map keys must be strings
+ *  - unsigned integers larger than INT64_MAX are rejected
+ *  - ext types are rejected
+ * bin is mapped to MPV_FORMAT_BYTE_ARRAY and back.
+ *
+ * The writer always picks the shortest encoding for integers, strings and
+ * container headers, and writes all doubles as float64.
+ *
+ * Also see: https://github.com/msgpack/msgpack/blob/master/spec.md
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common/common.h"
+#include "mpv_talloc.h"
+
+#include "msgpack.h"
+
+static bool read_bytes(bstr *src, void *dst, size_t len)
+{
+    if (src->len < len)
+        return false;
+    memcpy(dst, src->start, len);
+    *src = bstr_cut(*src, len);
+    return true;
+}
+
+static bool read_uint(bstr *src, int bytes, uint64_t *out)
+{
+    if (src->len < bytes)
+        return false;
+    uint64_t v = 0;
+    for (int n = 0; n < bytes; n++)
+        v = (v << 8) | src->start[n];
+    *src = bstr_cut(*src, bytes);
+    *out = v;
+    return true;
+}
+
+static char *read_str(void *ta_parent, bstr *src, uint64_t len)
+{
+    if (src->len < len)
+        return NULL;
+    char *s = talloc_strndup(ta_parent, src->start, len);
+    *src = bstr_cut(*src, len);
+    return s;
+}
+
+static int read_list(void *ta_parent, struct mpv_node *dst, bstr *src,
+                     uint64_t num, bool is_map, int max_depth);
+
+static int read_node(void *ta_parent, struct mpv_node *dst, bstr *src,
+                     int max_depth)
+{
+    if (max_depth < 0)
+        return -1;
+
+    uint8_t c;
+    if (!read_bytes(src, &c, 1))
+        return -1;
+
+    uint64_t u;
+
+    if (c <= 0x7f) {
+        *dst = (struct mpv_node){.format = MPV_FORMAT_INT64, .u.int64 = c};
+        return 0;
+    }
+    if (c >= 0xe0) {
+        *dst = (struct mpv_node){.format = MPV_FORMAT_INT64,
+                                 .u.int64 = (int8_t)c};
+        return 0;
+    }
+    if ((c & 0xf0) == 0x80)
+        return read_list(ta_parent, dst, src, c & 0x0f, true, max_depth);
+    if ((c & 0xf0) == 0x90)
+        return read_list(ta_parent, dst, src, c & 0x0f, false, max_depth);
+    if ((c & 0xe0) == 0xa0) {
+        u = c & 0x1f;
+        goto str;
+    }
+
+    switch (c) {
+    case 0xc0:
+        *dst = (struct mpv_node){.format = MPV_FORMAT_NONE};
+        return 0;
+    case 0xc2:
+    case 0xc3:
+        *dst = (struct mpv_node){.format = MPV_FORMAT_FLAG,
+                                 .u.flag = c == 0xc3};
+        return 0;
+    case 0xc4:
+    case 0xc5:
+    case 0xc6: {
+        if (!read_uint(src, 1 << (c - 0xc4), &u) || src->len < u)
+            return -1;
+        struct mpv_byte_array *ba = talloc_ptrtype(ta_parent, ba);
+        *ba = (struct mpv_byte_array){
+            .data = talloc_memdup(ba, src->start, u),
+            .size = u,
+        };
+        *src = bstr_cut(*src, u);
+        *dst = (struct mpv_node){.format = MPV_FORMAT_BYTE_ARRAY, .u.ba = ba};
+        return 0;
+    }
+    case 0xca: {
+        if (!read_uint(src, 4, &u))
+            return -1;
+        uint32_t bits = u;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        *dst = (struct mpv_node){.format = MPV_FORMAT_DOUBLE, .u.double_ = f};
+        return 0;
+    }
+    case 0xcb: {
+        if (!read_uint(src, 8, &u))
+            return -1;
+        double d;
+        memcpy(&d, &u, sizeof(d));
+        *dst = (struct mpv_node){.format = MPV_FORMAT_DOUBLE, .u.double_ = d};
+        return 0;
+    }
+    case 0xcc:
+    case 0xcd:
+    case 0xce:
+    case 0xcf:
+        if (!read_uint(src, 1 << (c - 0xcc), &u) || u > INT64_MAX)
+            return -1;
+        *dst = (struct mpv_node){.format = MPV_FORMAT_INT64, .u.int64 = u};
+        return 0;
+    case 0xd0:
+    case 0xd1:
+    case 0xd2:
+    case 0xd3: {
+        int bytes = 1 << (c - 0xd0);
+        if (!read_uint(src, bytes, &u))
+            return -1;
+        // Sign-extend.
+        int shift = 64 - bytes * 8;
+        int64_t v = shift ? (int64_t)(u << shift) >> shift : (int64_t)u;
+        *dst = (struct mpv_node){.format = MPV_FORMAT_INT64, .u.int64 = v};
+        return 0;
+    }
+    case 0xd9:
+    case 0xda:
+    case 0xdb:
+        if (!read_uint(src, 1 << (c - 0xd9), &u))
+            return -1;
+        goto str;
+    case 0xdc:
+    case 0xdd:
+        if (!read_uint(src, 2 << (c - 0xdc), &u))
+            return -1;
+        return read_list(ta_parent, dst, src, u, false, max_depth);
+    case 0xde:
+    case 0xdf:
+        if (!read_uint(src, 2 << (c - 0xde), &u))
+            return -1;
+        return read_list(ta_parent, dst, src, u, true, max_depth);
+    }
+    return -1; // reserved or ext type
+
+str: ;
+    char *s = read_str(ta_parent, src, u);
+    if (!s)
+        return -1;
+    *dst = (struct mpv_node){.format = MPV_FORMAT_STRING, .u.string = s};
+    return 0;
+}
+
+static int read_list(void *ta_parent, struct mpv_node *dst, bstr *src,
+                     uint64_t num, bool is_map, int max_depth)
+{
+    // Every item needs at least 1 byte (2 for map entries); this rejects
+    // bogus sizes before allocating anything.
+    if (num > src->len / (is_map ? 2 : 1))
+        return -1;
+
+    struct mpv_node_list *list = talloc_zero(ta_parent, struct mpv_node_list);
+    list->num = num;
+    list->values = talloc_array(list, struct mpv_node, num);
+    if (is_map)
+        list->keys = talloc_array(list, char *, num);
+
+    for (int n = 0; n < num; n++) {
+        if (is_map) {
+            struct mpv_node key;
+            if (read_node(list, &key, src, max_depth - 1) < 0 ||
+                key.format != MPV_FORMAT_STRING)
+                return -1;
+            list->keys[n] = key.u.string;
+        }
+        if (read_node(list, &list->values[n], src, max_depth - 1) < 0)
+            return -1;
+    }
+
+    *dst = (struct mpv_node){
+        .format = is_map ? MPV_FORMAT_NODE_MAP : MPV_FORMAT_NODE_ARRAY,
+        .u.list = list,
+    };
+    return 0;
+}
+
+/* Parse a single MessagePack value from the start of *src, and write it to
+ * *dst. On success, *src is advanced past the value. All memory is allocated
+ * with ta_parent as parent (also on failure).
+ * Returns: 0 on success, <0 on failure.
+ */
+int msgpack_parse(void *ta_parent, struct mpv_node *dst, bstr *src,
+                  int max_depth)
+{
+    bstr s = *src;
+    if (read_node(ta_parent, dst, &s, max_depth) < 0)
+        return -1;
+    *src = s;
+    return 0;
+}
+
+static void write_uint(void *ta, bstr *b, uint8_t tag, int bytes, uint64_t v)
+{
+    uint8_t buf[9] = {tag};
+    for (int n = 0; n < bytes; n++)
+        buf[1 + n] = v >> ((bytes - 1 - n) * 8);
+    bstr_xappend(ta, b, (bstr){buf, 1 + bytes});
+}
+
+// Write a header for types with fix/8/16/32 variants (tag8 == 0 means there
+// is no 8 bit variant).
+static void write_header(void *ta, bstr *b, uint8_t fix, int fix_max,
+                         uint8_t tag8, uint8_t tag16, uint64_t len)
+{
+    if (len <= fix_max) {
+        write_uint(ta, b, fix | len, 0, 0);
+    } else if (tag8 && len <= UINT8_MAX) {
+        write_uint(ta, b, tag8, 1, len);
+    } else if (len <= UINT16_MAX) {
+        write_uint(ta, b, tag16, 2, len);
+    } else {
+        write_uint(ta, b, tag16 + 1, 4, len);
+    }
+}
+
+static void write_str(void *ta, bstr *b, const char *s)
+{
+    size_t len = strlen(s);
+    write_header(ta, b, 0xa0, 31, 0xd9, 0xda, len);
+    bstr_xappend(ta, b, (bstr){(unsigned char *)s, len});
+}
+
+static int write_node(void *ta, bstr *b, const struct mpv_node *src)
+{
+    switch (src->format) {
+    case MPV_FORMAT_NONE:
+        write_uint(ta, b, 0xc0, 0, 0);
+        return 0;
+    case MPV_FORMAT_FLAG:
+        write_uint(ta, b, src->u.flag ? 0xc3 : 0xc2, 0, 0);
+        return 0;
+    case MPV_FORMAT_INT64: {
+        int64_t v = src->u.int64;
+        if (v >= 0 && v <= 0x7f) {
+            write_uint(ta, b, v, 0, 0);
+        } else if (v < 0 && v >= -32) {
+            write_uint(ta, b, (uint8_t)v, 0, 0);
+        } else if (v >= INT8_MIN && v <= INT8_MAX) {
+            write_uint(ta, b, 0xd0, 1, v);
+        } else if (v >= INT16_MIN && v <= INT16_MAX) {
+            write_uint(ta, b, 0xd1, 2, v);
+        } else if (v >= INT32_MIN && v <= INT32_MAX) {
+            write_uint(ta, b, 0xd2, 4, v);
+        } else {
+            write_uint(ta, b, 0xd3, 8, v);
+        }
+        return 0;
+    }
+    case MPV_FORMAT_DOUBLE: {
+        uint64_t bits;
+        memcpy(&bits, &src->u.double_, sizeof(bits));
+        write_uint(ta, b, 0xcb, 8, bits);
+        return 0;
+    }
+    case MPV_FORMAT_STRING:
+        write_str(ta, b, src->u.string);
+        return 0;
+    case MPV_FORMAT_BYTE_ARRAY: {
+        struct mpv_byte_array *ba = src->u.ba;
+        if (ba->size <= UINT8_MAX) {
+            write_uint(ta, b, 0xc4, 1, ba->size);
+        } else if (ba->size <= UINT16_MAX) {
+            write_uint(ta, b, 0xc5, 2, ba->size);
+        } else {
+            write_uint(ta, b, 0xc6, 4, ba->size);
+        }
+        bstr_xappend(ta, b, (bstr){ba->data, ba->size});
+        return 0;
+    }
+    case MPV_FORMAT_NODE_ARRAY:
+    case MPV_FORMAT_NODE_MAP: {
+        struct mpv_node_list *list = src->u.list;
+        bool is_map = src->format == MPV_FORMAT_NODE_MAP;
+        int num = list ? list->num : 0;
+        if (is_map) {
+            write_header(ta, b, 0x80, 15, 0, 0xde, num);
+        } else {
+            write_header(ta, b, 0x90, 15, 0, 0xdc, num);
+        }
+        for (int n = 0; n < num; n++) {
+            if (is_map)
+                write_str(ta, b, list->keys[n]);
+            if (write_node(ta, b, &list->values[n]) < 0)
+                return -1;
+        }
+        return 0;
+    }
+    }
+    return -1; // unknown format
+}
+
+/* Write the contents of *src as MessagePack, and append it to *dst. Memory
+ * is allocated as with bstr_xappend().
+ * Returns: 0 on success, <0 on failure.
+ */
+int msgpack_write(void *talloc_ctx, bstr *dst, struct mpv_node *src)
+{
+    return write_node(talloc_ctx, dst, src);
+}
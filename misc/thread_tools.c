@@ -267,3 +267,72 @@ void *mp_cancel_get_event(struct mp_cancel *c)
     return c->win32_event;
 }
 #endif
+
+struct mp_mpsc_queue {
+    size_t elem_size;
+    uint64_t mask;              // number of slots - 1
+    // seqs[n] == pos: slot n is free for the producer claiming pos
+    // seqs[n] == pos + 1: slot n contains the item at pos
+    mp_atomic_uint64 *seqs;
+    char *items;
+    mp_atomic_uint64 tail;      // next position claimed by a producer
+    uint64_t head;              // next position read by the consumer
+};
+
+struct mp_mpsc_queue *mp_mpsc_queue_create(void *ta_parent, size_t elem_size,
+                                           size_t capacity)
+{
+    size_t slots = 1;
+    while (slots < capacity)
+        slots *= 2;
+
+    struct mp_mpsc_queue *q = talloc_zero(ta_parent, struct mp_mpsc_queue);
+    q->elem_size = elem_size;
+    q->mask = slots - 1;
+    q->seqs = talloc_array(q, mp_atomic_uint64, slots);
+    for (size_t n = 0; n < slots; n++)
+        atomic_store(&q->seqs[n], n);
+    q->items = talloc_array(q, char, slots * elem_size);
+    return q;
+}
+
+bool mp_mpsc_queue_push(struct mp_mpsc_queue *q, const void *item)
+{
+    uint64_t pos = atomic_load(&q->tail);
+    while (1) {
+        uint64_t seq = atomic_load(&q->seqs[pos & q->mask]);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            // Slot is free; try to claim it. On failure, pos is updated.
+            if (atomic_compare_exchange_strong(&q->tail, &pos, pos + 1))
+                break;
+        } else if (diff < 0) {
+            return false; // the consumer didn't free the slot yet
+        } else {
+            pos = atomic_load(&q->tail); // another producer claimed it
+        }
+    }
+    memcpy(q->items + (pos & q->mask) * q->elem_size, item, q->elem_size);
+    atomic_store(&q->seqs[pos & q->mask], pos + 1);
+    return true;
+}
+
+void *mp_mpsc_queue_peek(struct mp_mpsc_queue *q)
+{
+    uint64_t pos = q->head;
+    if (atomic_load(&q->seqs[pos & q->mask]) != pos + 1)
+        return NULL;
+    return q->items + (pos & q->mask) * q->elem_size;
+}
+
+bool mp_mpsc_queue_pop(struct mp_mpsc_queue *q, void *item)
+{
+    void *ptr = mp_mpsc_queue_peek(q);
+    if (!ptr)
+        return false;
+    if (item)
+        memcpy(item, ptr, q->elem_size);
+    uint64_t pos = q->head++;
+    atomic_store(&q->seqs[pos & q->mask], pos + q->mask + 1);
+    return true;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <pthread.h>
@@ -80,3 +81,25 @@ void *mp_cancel_get_event(struct mp_cancel *c);
 // The FD becomes readable if mp_cancel_test() would return true.
 // Don't actually read from it, just use it for poll().
 int mp_cancel_get_fd(struct mp_cancel *c);
+
+// Bounded lock-free FIFO for fixed size items, with any number of producer
+// threads and a single consumer thread (multi-producer, single-consumer).
+struct mp_mpsc_queue;
+
+// Create a queue that can hold at least capacity items of elem_size bytes.
+struct mp_mpsc_queue *mp_mpsc_queue_create(void *ta_parent, size_t elem_size,
+                                           size_t capacity);
+
+// Copy item into the queue. Returns false if the queue is full. Can be called
+// from any thread.
+bool mp_mpsc_queue_push(struct mp_mpsc_queue *q, const void *item);
+
+// Return a pointer to the oldest item, or NULL if the queue is empty. The item
+// stays valid until the next mp_mpsc_queue_pop() call. Consumer thread only.
+// Note that an item whose push is still in progress can make the queue appear
+// empty, even if newer items are already complete.
+void *mp_mpsc_queue_peek(struct mp_mpsc_queue *q);
+
+// Remove the oldest item and copy it to item (if not NULL). Returns false if
+// the queue is empty. Consumer thread only.
+bool mp_mpsc_queue_pop(struct mp_mpsc_queue *q, void *item);
@@ -103,6 +103,9 @@ struct config_cache {
 struct m_group_data {
     char *udata;        // pointer to group user option struct
     uint64_t ts;        // timestamp of the data copy
+    uint64_t *opt_ts;   // shadow data only: per-option timestamp of the last
+                        // write (NULL if no option was written yet), indexed
+                        // like m_config_group.group->opts
 };
 
 static const union m_option_value default_value = {0};
@@ -612,7 +615,9 @@ static void update_next_option(struct m_config_cache *cache, void **p_opt)
             while (opts && opts[in->upd_opt].name) {
                 const struct m_option *opt = &opts[in->upd_opt];
 
-                if (opt->offset >= 0 && opt->type->size) {
+                // Only options written since our copy can differ.
+                if (gsrc->opt_ts && gsrc->opt_ts[in->upd_opt] > gdst->ts) {
+                    assert(opt->offset >= 0 && opt->type->size);
                     void *dsrc = gsrc->udata + opt->offset;
                     void *ddst = gdst->udata + opt->offset;
 
@@ -758,6 +763,10 @@ bool m_config_cache_write_opt(struct m_config_cache *cache, void *ptr)
 
         gsrc->ts = atomic_fetch_add(&shadow->ts, 1) + 1;
 
+        if (!gsrc->opt_ts)
+            gsrc->opt_ts = talloc_zero_array(in->src, uint64_t, g->opt_count);
+        gsrc->opt_ts[opt_idx] = gsrc->ts;
+
         for (int n = 0; n < shadow->num_listeners; n++) {
             struct config_cache *listener = shadow->listeners[n];
             if (listener->wakeup_cb && m_config_gdata(listener->data, group_idx))
@@ -292,10 +292,20 @@ struct m_config_option *m_config_get_co_raw(const struct m_config *config,
     if (!name.len)
         return NULL;
 
-    for (int n = 0; n < config->num_opts; n++) {
-        struct m_config_option *co = &config->opts[n];
-        struct bstr coname = bstr0(co->name);
-        if (bstrcmp(coname, name) == 0)
+    // Binary search for the first entry >= name.
+    int lo = 0, hi = config->num_opts;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (bstrcmp(bstr0(config->opts_by_name[mid]->name), name) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo < config->num_opts) {
+        struct m_config_option *co = config->opts_by_name[lo];
+        if (bstrcmp(bstr0(co->name), name) == 0)
             return co;
     }
 
@@ -545,6 +555,15 @@ static void config_destroy(void *p)
     talloc_free(config->shadow);
 }
 
+static int compare_opt_name(const void *pa, const void *pb)
+{
+    const struct m_config_option *a = *(struct m_config_option **)pa;
+    const struct m_config_option *b = *(struct m_config_option **)pb;
+    int r = strcmp(a->name, b->name);
+    // Keep declaration order for duplicate names (first one wins on lookup).
+    return r ? r : (a > b) - (a < b);
+}
+
 struct m_config *m_config_new(void *talloc_ctx, struct mp_log *log,
                               const struct m_sub_options *root)
 {
@@ -565,8 +584,10 @@ struct m_config *m_config_new(void *talloc_ctx, struct mp_log *log,
         const char *opt_name =
             m_config_shadow_get_opt_name(config->shadow, optid, buf, sizeof(buf));
 
+        // Unless it had to be concatenated, the name is static or owned by
+        // the shadow, which lives as long as config.
         struct m_config_option co = {
-            .name = talloc_strdup(config, opt_name),
+            .name = opt_name == buf ? talloc_strdup(config, opt_name) : opt_name,
             .opt = m_config_shadow_get_opt(config->shadow, optid),
             .opt_id = optid,
         };
@@ -577,6 +598,13 @@ struct m_config *m_config_new(void *talloc_ctx, struct mp_log *log,
         MP_TARRAY_APPEND(config, config->opts, config->num_opts, co);
     }
 
+    config->opts_by_name =
+        talloc_array(config, struct m_config_option *, config->num_opts);
+    for (int n = 0; n < config->num_opts; n++)
+        config->opts_by_name[n] = &config->opts[n];
+    qsort(config->opts_by_name, config->num_opts,
+          sizeof(config->opts_by_name[0]), compare_opt_name);
+
     return config;
 }
 
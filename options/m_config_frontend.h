@@ -65,6 +65,8 @@ typedef struct m_config {
     // Registered options.
     struct m_config_option *opts; // all options, even suboptions
     int num_opts;
+    // Same as opts, sorted by name (for m_config_get_co_raw()).
+    struct m_config_option **opts_by_name;
 
     // List of defined profiles.
     struct m_profile *profiles;
@@ -37,7 +37,7 @@
 #include "common/common.h"
 
 static int m_property_multiply(struct mp_log *log,
-                               const struct m_property *prop_list,
+                               const struct m_property_list *prop_list,
                                const char *property, double f, void *ctx)
 {
     union m_option_value val = {0};
@@ -62,17 +62,45 @@ static int m_property_multiply(struct mp_log *log,
     return r;
 }
 
-struct m_property *m_property_list_find(const struct m_property *list,
+static int compare_prop(const void *a, const void *b)
+{
+    const struct m_property *pa = *(struct m_property **)a;
+    const struct m_property *pb = *(struct m_property **)b;
+    return strcmp(pa->name, pb->name);
+}
+
+static int compare_prop_name(const void *key, const void *elem)
+{
+    const struct m_property *p = *(struct m_property **)elem;
+    return strcmp(key, p->name);
+}
+
+void m_property_list_init(void *ta_parent, struct m_property_list *list,
+                          struct m_property *props, int num_props)
+{
+    struct m_property **sorted =
+        talloc_realloc(ta_parent, list->sorted, struct m_property *, num_props);
+    for (int n = 0; n < num_props; n++)
+        sorted[n] = &props[n];
+    qsort(sorted, num_props, sizeof(sorted[0]), compare_prop);
+    *list = (struct m_property_list){
+        .props = props,
+        .num_props = num_props,
+        .sorted = sorted,
+    };
+}
+
+struct m_property *m_property_list_find(const struct m_property_list *list,
                                         const char *name)
 {
-    for (int n = 0; list && list[n].name; n++) {
-        if (strcmp(list[n].name, name) == 0)
-            return (struct m_property *)&list[n];
-    }
-    return NULL;
+    if (!list || !list->num_props)
+        return NULL;
+    struct m_property **p = bsearch(name, list->sorted, list->num_props,
+                                    sizeof(list->sorted[0]), compare_prop_name);
+    return p ? *p : NULL;
 }
 
-static int do_action(const struct m_property *prop_list, const char *name,
+static int do_action(const struct m_property_list *prop_list, const char *name,
                      int action, void *arg, void *ctx)
 {
     struct m_property *prop;
@@ -97,7 +125,7 @@ static int do_action(const struct m_property *prop_list, const char *name,
 }
 
 // (as a hack, log can be NULL on read-only paths)
-int m_property_do(struct mp_log *log, const struct m_property *prop_list,
+int m_property_do(struct mp_log *log, const struct m_property_list *prop_list,
                   const char *name, int action, void *arg, void *ctx)
 {
     union m_option_value val = {0};
@@ -236,7 +264,7 @@ static void m_property_unkey(int *action, void **arg)
     }
 }
 
-static int m_property_do_bstr(const struct m_property *prop_list, bstr name,
+static int m_property_do_bstr(const struct m_property_list *prop_list, bstr name,
                               int action, void *arg, void *ctx)
 {
     char name0[64];
@@ -254,7 +282,7 @@ static void append_str(char **s, int *len, bstr append)
     *len = *len + append.len;
 }
 
-static int expand_property(const struct m_property *prop_list, char **ret,
+static int expand_property(const struct m_property_list *prop_list, char **ret,
                            int *ret_len, bstr prop, bool silent_error, void *ctx)
 {
     bool cond_yes = bstr_eatstart0(&prop, "?");
@@ -285,7 +313,7 @@ static int expand_property(const struct m_property *prop_list, char **ret,
     return skip;
 }
 
-char *m_properties_expand_string(const struct m_property *prop_list,
+char *m_properties_expand_string(const struct m_property_list *prop_list,
                                  const char *str0, void *ctx)
 {
     char *ret = NULL;
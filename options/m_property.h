@@ -135,14 +135,28 @@ struct m_property {
     bool is_option;
 };
 
-struct m_property *m_property_list_find(const struct m_property *list,
+// Index for fast lookup of properties by name. The m_property array is not
+// copied, and keeps its order.
+struct m_property_list {
+    struct m_property *props;
+    int num_props;
+    struct m_property **sorted; // props[] sorted by name
+};
+
+// list must be zero-initialized, or have been initialized before (in which
+// case its index is reallocated).
+void m_property_list_init(void *ta_parent, struct m_property_list *list,
+                          struct m_property *props, int num_props);
+
+// Return the property with the given name, or NULL. O(log(num_props)).
+struct m_property *m_property_list_find(const struct m_property_list *list,
                                         const char *name);
 
 // Access a property.
 // action: one of m_property_action
 // ctx: opaque value passed through to property implementation
 // returns: one of mp_property_return
-int m_property_do(struct mp_log *log, const struct m_property* prop_list,
+int m_property_do(struct mp_log *log, const struct m_property_list *prop_list,
                   const char* property_name, int action, void* arg, void *ctx);
 
 // Given a path of the form "a/b/c", this function will set *prefix to "a",
@@ -167,7 +181,7 @@ void m_properties_print_help_list(struct mp_log *log,
 // STR is recursively expanded using the same rules.
 // "$$" can be used to escape "$", and "$}" to escape "}".
 // "$>" disables parsing of "$" for the rest of the string.
-char* m_properties_expand_string(const struct m_property *prop_list,
+char* m_properties_expand_string(const struct m_property_list *prop_list,
                                  const char *str, void *ctx);
 
 // Trivial helpers for implementing properties.
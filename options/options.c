@@ -61,6 +61,7 @@ extern const struct m_sub_options tv_params_conf;
 extern const struct m_sub_options stream_cdda_conf;
 extern const struct m_sub_options stream_dvb_conf;
 extern const struct m_sub_options stream_lavf_conf;
+extern const struct m_sub_options lua_conf;
 extern const struct m_sub_options sws_conf;
 extern const struct m_sub_options zimg_conf;
 extern const struct m_sub_options drm_conf;
@@ -69,6 +70,7 @@ extern const struct m_sub_options demux_rawvideo_conf;
 extern const struct m_sub_options demux_lavf_conf;
 extern const struct m_sub_options demux_mkv_conf;
 extern const struct m_sub_options demux_cue_conf;
+extern const struct m_sub_options demux_playlist_conf;
 extern const struct m_sub_options vd_lavc_conf;
 extern const struct m_sub_options ad_lavc_conf;
 extern const struct m_sub_options input_config;
@@ -423,6 +425,9 @@ static const m_option_t mp_opts[] = {
         .flags = CONF_PRE_PARSE | UPDATE_TERM},
     {"dump-stats", OPT_STRING(dump_stats),
         .flags = UPDATE_TERM | CONF_PRE_PARSE | M_OPT_FILE},
+    {"dump-stats-format", OPT_CHOICE(dump_stats_format,
+        {"text", 0}, {"binary", 1}),
+        .flags = UPDATE_TERM | CONF_PRE_PARSE},
     {"msg-color", OPT_FLAG(msg_color), .flags = CONF_PRE_PARSE | UPDATE_TERM},
     {"log-file", OPT_STRING(log_file),
         .flags = CONF_PRE_PARSE | M_OPT_FILE | UPDATE_TERM},
@@ -462,6 +467,9 @@ static const m_option_t mp_opts[] = {
     {"load-auto-profiles",
         OPT_CHOICE(lua_load_auto_profiles, {"no", 0}, {"yes", 1}, {"auto", -1}),
         .flags = UPDATE_BUILTIN_SCRIPTS},
+    {"script-executor-threads", OPT_INT(script_executor_threads),
+        M_RANGE(0, 64)},
+    {"", OPT_SUBSTRUCT(lua_opts, lua_conf)},
 #endif
 
 // ------------------------- stream options --------------------
@@ -591,6 +599,7 @@ static const m_option_t mp_opts[] = {
     {"demuxer-rawvideo", OPT_SUBSTRUCT(demux_rawvideo, demux_rawvideo_conf)},
     {"demuxer-mkv", OPT_SUBSTRUCT(demux_mkv, demux_mkv_conf)},
     {"demuxer-cue", OPT_SUBSTRUCT(demux_cue, demux_cue_conf)},
+    {"", OPT_SUBSTRUCT(demux_playlist, demux_playlist_conf)},
 
 // ------------------------- subtitles options --------------------
 
@@ -654,6 +663,11 @@ static const m_option_t mp_opts[] = {
         {"no", 0},
         {"yes", 1},
         {"weak", -1})},
+    {"gapless-audio-prebuffer", OPT_DOUBLE(gapless_prebuffer),
+        M_RANGE(0, 60)},
+    {"gapless-audio-prebuffer-max-bytes",
+        OPT_BYTE_SIZE(gapless_prebuffer_max_bytes),
+        M_RANGE(0, M_MAX_MEM_BYTES)},
 
     {"title", OPT_STRING(wintitle)},
     {"force-media-title", OPT_STRING(media_title)},
@@ -770,6 +784,7 @@ static const m_option_t mp_opts[] = {
     {"input-ipc-server", OPT_STRING(ipc_path), .flags = M_OPT_FILE},
 #if HAVE_POSIX
     {"input-ipc-client", OPT_STRING(ipc_client)},
+    {"input-ipc-server-multiplex", OPT_FLAG(ipc_multiplex)},
 #endif
 
     {"screenshot", OPT_SUBSTRUCT(screenshot_image_opts, screenshot_conf)},
@@ -973,6 +988,7 @@ static const struct MPOpts mp_default_opts = {
     .softvol_volume = 100,
     .softvol_mute = 0,
     .gapless_audio = -1,
+    .gapless_prebuffer_max_bytes = 32 * 1024 * 1024,
     .wintitle = "${?media-title:${media-title}}${!media-title:No file} - mpv",
     .stop_screensaver = 1,
     .cursor_autohide_delay = 1000,
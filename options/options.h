@@ -137,6 +137,7 @@ typedef struct MPOpts {
     int property_print_help;
     int use_terminal;
     char *dump_stats;
+    int dump_stats_format;
     int verbose;
     int msg_really_quiet;
     char **msg_levels;
@@ -158,6 +159,8 @@ typedef struct MPOpts {
     int lua_load_stats;
     int lua_load_console;
     int lua_load_auto_profiles;
+    int script_executor_threads;
+    struct lua_opts *lua_opts;
 
     int auto_load_scripts;
 
@@ -174,6 +177,8 @@ typedef struct MPOpts {
     int softvol_mute;
     float softvol_max;
     int gapless_audio;
+    double gapless_prebuffer;
+    int64_t gapless_prebuffer_max_bytes;
 
     mp_vo_opts *vo;
     struct ao_opts *ao_opts;
@@ -327,6 +332,7 @@ typedef struct MPOpts {
     struct demux_lavf_opts *demux_lavf;
     struct demux_mkv_opts *demux_mkv;
     struct demux_cue_opts *demux_cue;
+    struct demux_playlist_opts *demux_playlist;
 
     struct demux_opts *demux_opts;
     struct demux_cache_opts *demux_cache_opts;
@@ -342,6 +348,7 @@ typedef struct MPOpts {
 
     char *ipc_path;
     char *ipc_client;
+    int ipc_multiplex;
 
     int wingl_dwm_flush;
 
@@ -214,6 +214,7 @@ static void ao_chain_reset_state(struct ao_chain *ao_c)
     ao_c->underrun = false;
     ao_c->start_pts_known = false;
     ao_c->start_pts = MP_NOPTS_VALUE;
+    ao_c->gapless_start_pts = MP_NOPTS_VALUE;
     ao_c->untimed_throttle = false;
     ao_c->underrun = false;
 }
@@ -229,6 +230,31 @@ void reset_audio_state(struct MPContext *mpctx)
     mpctx->audio_status = mpctx->ao_chain ? STATUS_SYNCING : STATUS_EOF;
     mpctx->delay = 0;
     mpctx->logged_async_diff = -1;
+
+    if (mpctx->ao && mpctx->ao_prebuffering)
+        ao_set_prebuffer(mpctx->ao, 0, 0);
+    mpctx->ao_prebuffering = false;
+}
+
+// Called once the demuxer has read everything. If the next playlist entry is
+// likely going to reuse the AO (gapless audio), let the AO queue the remaining
+// audio of the current file, so it can cover the time needed to open and
+// start decoding the next file.
+void audio_start_gapless_prebuffer(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+
+    if (mpctx->ao_prebuffering || !mpctx->ao || !mpctx->ao_chain ||
+        !opts->gapless_audio || opts->gapless_prebuffer <= 0 ||
+        mpctx->play_dir < 0 || mpctx->vo_chain)
+        return;
+
+    if (!mp_next_file(mpctx, +1, false, false))
+        return;
+
+    ao_set_prebuffer(mpctx->ao, opts->gapless_prebuffer,
+                     opts->gapless_prebuffer_max_bytes);
+    mpctx->ao_prebuffering = true;
 }
 
 void uninit_audio_out(struct MPContext *mpctx)
@@ -252,6 +278,7 @@ void uninit_audio_out(struct MPContext *mpctx)
         mp_notify(mpctx, MPV_EVENT_AUDIO_RECONFIG, NULL);
     }
     mpctx->ao = NULL;
+    mpctx->ao_prebuffering = false;
     TA_FREEP(&mpctx->ao_filter_fmt);
 }
 
@@ -737,6 +764,7 @@ static void ao_process(struct mp_filter *f)
         // If the new audio starts "later" (big video sync offset), transfer
         // of data is stopped somewhere else.
         if (mpctx->audio_status == STATUS_SYNCING && ao_is_playing(ao_c->ao)) {
+            ao_c->gapless_start_pts = mp_aframe_get_pts(af);
             mpctx->audio_status = STATUS_READY;
             mp_wakeup_core(mpctx);
             MP_VERBOSE(mpctx, "previous audio still playing; continuing\n");
@@ -942,6 +970,7 @@ void fill_audio_out_buffers(struct MPContext *mpctx)
         } else {
             if (!ao_c->ao_underrun) {
                 MP_WARN(mpctx, "Audio device underrun detected.\n");
+                ao_report_underrun(ao_c->ao);
                 ao_c->ao_underrun = true;
                 mp_wakeup_core(mpctx);
                 ao_c->underrun = true;
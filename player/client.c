@@ -83,6 +83,20 @@ struct mp_client_api {
     int num_custom_protocols;
 
     struct mpv_render_context *render_context;
+
+    // Property values read by mp_client_send_property_changes(), shared by all
+    // clients observing the same property with the same format. Also contains
+    // values pushed with mp_client_property_change_value(). Cleared after
+    // each mp_client_send_property_changes() call.
+    struct prop_snapshot *snapshot;
+    int num_snapshot;
+};
+
+struct prop_snapshot {
+    char *name;
+    mpv_format format;
+    int status;                 // as in getproperty_request.status
+    union m_option_value value; // only set if status >= 0
 };
 
 struct observe_property {
@@ -94,6 +108,8 @@ struct observe_property {
     int64_t reply_id;
     mpv_format format;
     const struct m_option *type;
+    int64_t min_interval_us; // minimum time between change events (0=off)
+    double min_delta;       // minimum numeric change for change events (0=off)
     // -- protected by owner->lock
     size_t refcount;
     uint64_t change_ts;     // logical timestamp incremented on each change
@@ -103,6 +119,7 @@ struct observe_property {
     uint64_t value_ret_ts;  // logical timestamp of value returned to user
     union m_option_value value_ret;
     bool waiting_for_hook;  // flag for draining old property changes on a hook
+    int64_t last_update_us; // mp_time_us() of the last value change (or 0)
 };
 
 struct mpv_handle {
@@ -123,24 +140,27 @@ struct mpv_handle {
     pthread_mutex_t wakeup_lock;
     pthread_cond_t wakeup;
 
-    // -- protected by wakeup_lock
-    bool need_wakeup;
+    // -- protected by wakeup_lock (need_wakeup can be read without)
+    atomic_bool need_wakeup;
     void (*wakeup_cb)(void *d);
     void *wakeup_cb_ctx;
     int wakeup_pipe[2];
 
+    // -- lock-free; events are added by any thread, and read by the client
+    //    thread in mpv_wait_event() only
+
+    mp_atomic_uint64 event_mask;
+    struct mp_mpsc_queue *events; // queue of mpv_event
+    int max_events;         // maximum number of queued + reserved entries
+    atomic_int used_events; // number of queued and reserved entries
+    atomic_int reserved_events; // number of entries reserved for replies
+    atomic_bool choked;     // recovering from queue overflow
+    mp_atomic_uint64 dropped_events; // events lost since the last overflow
+
     // -- protected by lock
 
-    uint64_t event_mask;
     bool queued_wakeup;
-
-    mpv_event *events;      // ringbuffer of max_events entries
-    int max_events;         // allocated number of entries in events
-    int first_event;        // events[first_event] is the first readable event
-    int num_events;         // number of readable events
-    int reserved_events;    // number of entries reserved for replies
     size_t async_counter;   // pending other async events
-    bool choked;            // recovering from queue overflow
     bool destroying;        // pending destruction; no API accesses allowed
     bool hook_pending;      // hook events are returned after draining properties
 
@@ -149,7 +169,8 @@ struct mpv_handle {
     bool has_pending_properties; // (maybe) new property events (producer side)
     bool new_property_events; // new property events (consumer side)
     int cur_property_index; // round-robin for property events (consumer side)
-    uint64_t property_event_masks; // or-ed together event masks of all properties
+    mp_atomic_uint64 property_event_masks; // or-ed together event masks of all
+                                           // properties (written under lock)
     // This is incremented whenever the properties[] array above changes. This
     // is used to safely unlock mpv_handle.lock while reading a property. If
     // the counter didn't change between unlock and relock, then it will assume
@@ -163,6 +184,7 @@ struct mpv_handle {
 };
 
 static bool gen_log_message_event(struct mpv_handle *ctx);
+static void clear_snapshot(struct mp_client_api *clients);
 static bool gen_property_change_event(struct mpv_handle *ctx);
 static void notify_property_events(struct mpv_handle *ctx, int event);
 
@@ -201,6 +223,7 @@ void mp_clients_destroy(struct MPContext *mpctx)
         abort();
     }
 
+    clear_snapshot(mpctx->clients);
     pthread_mutex_destroy(&mpctx->clients->lock);
     talloc_free(mpctx->clients);
     mpctx->clients = NULL;
@@ -291,9 +314,9 @@ struct mpv_handle *mp_new_client(struct mp_client_api *clients, const char *name
         .clients = clients,
         .id = ++(clients->id_alloc),
         .cur_event = talloc_zero(client, struct mpv_event),
-        .events = talloc_array(client, mpv_event, num_events),
+        .events = mp_mpsc_queue_create(client, sizeof(mpv_event), num_events),
         .max_events = num_events,
-        .event_mask = (1ULL << INTERNAL_EVENT_BASE) - 1, // exclude internal events
+        .event_mask = ATOMIC_VAR_INIT((1ULL << INTERNAL_EVENT_BASE) - 1), // exclude internal events
         .wakeup_pipe = {-1, -1},
     };
     pthread_mutex_init(&client->lock, NULL);
@@ -344,9 +367,13 @@ struct mpv_global *mp_client_get_global(struct mpv_handle *ctx)
 
 static void wakeup_client(struct mpv_handle *ctx)
 {
+    // A pending wakeup was not consumed yet, so the client will look at the
+    // new state anyway. This avoids the lock when many events are sent.
+    if (atomic_load(&ctx->need_wakeup))
+        return;
     pthread_mutex_lock(&ctx->wakeup_lock);
-    if (!ctx->need_wakeup) {
-        ctx->need_wakeup = true;
+    if (!atomic_load(&ctx->need_wakeup)) {
+        atomic_store(&ctx->need_wakeup, true);
         pthread_cond_broadcast(&ctx->wakeup);
         if (ctx->wakeup_cb)
             ctx->wakeup_cb(ctx->wakeup_cb_ctx);
@@ -362,12 +389,12 @@ static int wait_wakeup(struct mpv_handle *ctx, int64_t end)
     int r = 0;
     pthread_mutex_unlock(&ctx->lock);
     pthread_mutex_lock(&ctx->wakeup_lock);
-    if (!ctx->need_wakeup) {
+    if (!atomic_load(&ctx->need_wakeup)) {
         struct timespec ts = mp_time_us_to_timespec(end);
         r = pthread_cond_timedwait(&ctx->wakeup, &ctx->wakeup_lock, &ts);
     }
     if (r == 0)
-        ctx->need_wakeup = false;
+        atomic_store(&ctx->need_wakeup, false);
     pthread_mutex_unlock(&ctx->wakeup_lock);
     pthread_mutex_lock(&ctx->lock);
     return r;
@@ -396,7 +423,7 @@ static void unlock_core(mpv_handle *ctx)
 void mpv_wait_async_requests(mpv_handle *ctx)
 {
     pthread_mutex_lock(&ctx->lock);
-    while (ctx->reserved_events || ctx->async_counter)
+    while (atomic_load(&ctx->reserved_events) || ctx->async_counter)
         wait_wakeup(ctx, INT64_MAX);
     pthread_mutex_unlock(&ctx->lock);
 }
@@ -473,11 +500,9 @@ static void mp_destroy_client(mpv_handle *ctx, bool terminate)
         if (clients->clients[n] == ctx) {
             clients->clients_list_change_ts += 1;
             MP_TARRAY_REMOVE_AT(clients->clients, clients->num_clients, n);
-            while (ctx->num_events) {
-                talloc_free(ctx->events[ctx->first_event].data);
-                ctx->first_event = (ctx->first_event + 1) % ctx->max_events;
-                ctx->num_events--;
-            }
+            mpv_event ev;
+            while (mp_mpsc_queue_pop(ctx->events, &ev))
+                talloc_free(ev.data);
             mp_msg_log_buffer_destroy(ctx->messages);
             pthread_cond_destroy(&ctx->wakeup);
             pthread_mutex_destroy(&ctx->wakeup_lock);
@@ -699,57 +724,64 @@ static void dup_event_data(struct mpv_event *ev)
     }
 }
 
-// Reserve an entry in the ring buffer. This can be used to guarantee that the
-// reply can be made, even if the buffer becomes congested _after_ sending
+// Claim an entry in the event queue. Fails if the queue is full or is
+// recovering from an overflow.
+static bool claim_event(struct mpv_handle *ctx)
+{
+    if (atomic_load(&ctx->choked))
+        return false;
+    int used = atomic_load(&ctx->used_events);
+    do {
+        if (used >= ctx->max_events)
+            return false;
+    } while (!atomic_compare_exchange_strong(&ctx->used_events, &used, used + 1));
+    return true;
+}
+
+// Reserve an entry in the event queue. This can be used to guarantee that the
+// reply can be made, even if the queue becomes congested _after_ sending
 // the request.
-// Returns an error code if the buffer is full.
+// Returns an error code if the queue is full.
 static int reserve_reply(struct mpv_handle *ctx)
 {
-    int res = MPV_ERROR_EVENT_QUEUE_FULL;
-    pthread_mutex_lock(&ctx->lock);
-    if (ctx->reserved_events + ctx->num_events < ctx->max_events && !ctx->choked)
-    {
-        ctx->reserved_events++;
-        res = 0;
-    }
-    pthread_mutex_unlock(&ctx->lock);
-    return res;
+    if (!claim_event(ctx))
+        return MPV_ERROR_EVENT_QUEUE_FULL;
+    atomic_fetch_add(&ctx->reserved_events, 1);
+    return 0;
 }
 
-static int append_event(struct mpv_handle *ctx, struct mpv_event event, bool copy)
+// Add an event to an entry previously claimed with claim_event().
+static void append_event(struct mpv_handle *ctx, struct mpv_event event)
 {
-    if (ctx->num_events + ctx->reserved_events >= ctx->max_events)
-        return -1;
-    if (copy)
-        dup_event_data(&event);
-    ctx->events[(ctx->first_event + ctx->num_events) % ctx->max_events] = event;
-    ctx->num_events++;
-    wakeup_client(ctx);
+    if (!mp_mpsc_queue_push(ctx->events, &event))
+        abort(); // not reached; the queue is larger than max_events
     if (event.event_id == MPV_EVENT_SHUTDOWN)
-        ctx->event_mask &= ctx->event_mask & ~(1ULL << MPV_EVENT_SHUTDOWN);
-    return 0;
+        atomic_fetch_and(&ctx->event_mask, ~(1ULL << MPV_EVENT_SHUTDOWN));
+    wakeup_client(ctx);
 }
 
 static int send_event(struct mpv_handle *ctx, struct mpv_event *event, bool copy)
 {
-    pthread_mutex_lock(&ctx->lock);
     uint64_t mask = 1ULL << event->event_id;
-    if (ctx->property_event_masks & mask)
+    if (atomic_load(&ctx->property_event_masks) & mask) {
+        pthread_mutex_lock(&ctx->lock);
         notify_property_events(ctx, event->event_id);
-    int r;
-    if (!(ctx->event_mask & mask)) {
-        r = 0;
-    } else if (ctx->choked) {
-        r = -1;
-    } else {
-        r = append_event(ctx, *event, copy);
-        if (r < 0) {
+        pthread_mutex_unlock(&ctx->lock);
+    }
+    if (!(atomic_load(&ctx->event_mask) & mask))
+        return 0;
+    if (!claim_event(ctx)) {
+        // Drop all events until the client has emptied the queue, and then
+        // send MPV_EVENT_QUEUE_OVERFLOW.
+        if (!atomic_exchange(&ctx->choked, true))
             MP_ERR(ctx, "Too many events queued.\n");
-            ctx->choked = true;
-        }
+        atomic_fetch_add(&ctx->dropped_events, 1);
+        return -1;
     }
-    pthread_mutex_unlock(&ctx->lock);
-    return r;
+    if (copy)
+        dup_event_data(event);
+    append_event(ctx, *event);
+    return 0;
 }
 
 // Send a reply; the reply must have been previously reserved with
@@ -758,13 +790,10 @@ static void send_reply(struct mpv_handle *ctx, uint64_t userdata,
                        struct mpv_event *event)
 {
     event->reply_userdata = userdata;
-    pthread_mutex_lock(&ctx->lock);
     // If this fails, reserve_reply() probably wasn't called.
-    assert(ctx->reserved_events > 0);
-    ctx->reserved_events--;
-    if (append_event(ctx, *event, false) < 0)
-        abort(); // not reached
-    pthread_mutex_unlock(&ctx->lock);
+    int reserved = atomic_fetch_add(&ctx->reserved_events, -1);
+    assert(reserved > 0);
+    append_event(ctx, *event);
 }
 
 void mp_client_broadcast_event(struct MPContext *mpctx, int event, void *data)
@@ -858,16 +887,18 @@ int mpv_request_event(mpv_handle *ctx, mpv_event_id event, int enable)
     if (event == MPV_EVENT_SHUTDOWN && !enable)
         return MPV_ERROR_INVALID_PARAMETER;
     assert(event < (int)INTERNAL_EVENT_BASE); // excluded above; they have no name
-    pthread_mutex_lock(&ctx->lock);
     uint64_t bit = 1ULL << event;
-    ctx->event_mask = enable ? ctx->event_mask | bit : ctx->event_mask & ~bit;
+    if (enable) {
+        atomic_fetch_or(&ctx->event_mask, bit);
+    } else {
+        atomic_fetch_and(&ctx->event_mask, ~bit);
+    }
     if (enable && event < MP_ARRAY_SIZE(deprecated_events) &&
         deprecated_events[event])
     {
         MP_WARN(ctx, "The '%s' event is deprecated and will be removed.\n",
                 mpv_event_name(event));
     }
-    pthread_mutex_unlock(&ctx->lock);
     return 0;
 }
 
@@ -913,14 +944,16 @@ mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
     while (1) {
         if (ctx->queued_wakeup)
             deadline = 0;
+        struct mpv_event *ev = mp_mpsc_queue_peek(ctx->events);
         // Recover from overflow.
-        if (ctx->choked && !ctx->num_events) {
-            ctx->choked = false;
+        if (atomic_load(&ctx->choked) && !ev) {
+            uint64_t dropped = atomic_exchange(&ctx->dropped_events, 0);
+            MP_WARN(ctx, "Event queue overflow, %"PRIu64" events were "
+                    "dropped.\n", dropped);
+            atomic_store(&ctx->choked, false);
             event->event_id = MPV_EVENT_QUEUE_OVERFLOW;
             break;
         }
-        struct mpv_event *ev =
-            ctx->num_events ? &ctx->events[ctx->first_event] : NULL;
         if (ev && ev->event_id == MPV_EVENT_HOOK) {
             // Give old property notifications priority over hooks. This is a
             // guarantee given to clients to simplify their logic. New property
@@ -936,9 +969,8 @@ mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
             }
         }
         if (ev) {
-            *event = *ev;
-            ctx->first_event = (ctx->first_event + 1) % ctx->max_events;
-            ctx->num_events--;
+            mp_mpsc_queue_pop(ctx->events, event);
+            atomic_fetch_add(&ctx->used_events, -1);
             talloc_steal(event, event->data);
             break;
         }
@@ -1374,6 +1406,137 @@ int mpv_set_property_async(mpv_handle *ctx, uint64_t ud, const char *name,
     return run_async(ctx, setproperty_fn, req);
 }
 
+struct batch_entry {
+    struct mp_cmd *cmd;         // command to run, or...
+    const char *property;       // ...property to set to value
+    struct mpv_node *value;
+    int status;
+    struct mpv_node result;
+};
+
+// Run all entries in order, taking the core lock only once. The lock is
+// released only while waiting for commands that complete on another thread.
+static void run_batch(mpv_handle *ctx, struct batch_entry *entries, int num)
+{
+    lock_core(ctx);
+    for (int n = 0; n < num; n++) {
+        struct batch_entry *e = &entries[n];
+
+        if (e->property) {
+            int err = mp_property_do(e->property, M_PROPERTY_SET_NODE,
+                                     e->value, ctx->mpctx);
+            e->status = translate_property_error(err);
+            continue;
+        }
+
+        struct mp_cmd *cmd = e->cmd;
+        if (!cmd)
+            continue;
+        e->cmd = NULL;
+
+        if (cmd->flags & MP_ASYNC_CMD) {
+            run_command(ctx->mpctx, cmd, NULL, NULL, NULL);
+            continue;
+        }
+
+        struct cmd_request req = {
+            .mpctx = ctx->mpctx,
+            .cmd = cmd,
+            .res = &e->result,
+            .completion = MP_WAITER_INITIALIZER,
+        };
+        struct mp_abort_entry *abort = NULL;
+        if (cmd->def->can_abort) {
+            abort = talloc_zero(NULL, struct mp_abort_entry);
+            abort->client = ctx;
+        }
+        run_command(ctx->mpctx, cmd, abort, cmd_complete, &req);
+
+        bool done = mp_waiter_poll(&req.completion);
+        if (!done)
+            unlock_core(ctx);
+        mp_waiter_wait(&req.completion);
+        if (!done)
+            lock_core(ctx);
+
+        e->status = req.status;
+    }
+    unlock_core(ctx);
+}
+
+int mpv_command_batch(mpv_handle *ctx, mpv_node *args, mpv_node *result)
+{
+    if (result)
+        *result = (mpv_node){.format = MPV_FORMAT_NONE};
+    if (!args || args->format != MPV_FORMAT_NODE_ARRAY)
+        return MPV_ERROR_INVALID_PARAMETER;
+    if (!ctx->mpctx->initialized)
+        return MPV_ERROR_UNINITIALIZED;
+
+    int num = args->u.list->num;
+    struct batch_entry *entries = talloc_zero_array(NULL, struct batch_entry, num);
+
+    for (int n = 0; n < num; n++) {
+        struct batch_entry *e = &entries[n];
+        struct mpv_node *item = &args->u.list->values[n];
+        struct mpv_node *prop = item->format == MPV_FORMAT_NODE_MAP ?
+                                node_map_get(item, "property") : NULL;
+        if (prop) {
+            e->value = node_map_get(item, "value");
+            if (prop->format == MPV_FORMAT_STRING && e->value) {
+                e->property = prop->u.string;
+            } else {
+                e->status = MPV_ERROR_INVALID_PARAMETER;
+            }
+        } else {
+            e->cmd = mp_input_parse_cmd_node(ctx->log, item);
+            if (e->cmd) {
+                e->cmd->sender = ctx->name;
+            } else {
+                e->status = MPV_ERROR_INVALID_PARAMETER;
+            }
+        }
+    }
+
+    run_batch(ctx, entries, num);
+
+    int err = 0;
+    struct mpv_node res;
+    node_init(&res, MPV_FORMAT_NODE_ARRAY, NULL);
+    for (int n = 0; n < num; n++) {
+        struct batch_entry *e = &entries[n];
+        if (e->status < 0 && err >= 0)
+            err = e->status;
+        struct mpv_node *entry = node_array_add(&res, MPV_FORMAT_NODE_MAP);
+        node_map_add_int64(entry, "error", e->status);
+        if (e->result.format != MPV_FORMAT_NONE) {
+            *node_map_add(entry, "data", MPV_FORMAT_NONE) = e->result;
+            talloc_steal(entry->u.list, node_get_alloc(&e->result));
+        }
+    }
+    talloc_free(entries);
+
+    if (result) {
+        *result = res;
+    } else {
+        mpv_free_node_contents(&res);
+    }
+    return err;
+}
+
+// Replace the int64 "error" field of each mpv_command_batch() result entry
+// with its mpv_error_string(). Used by frontends that report errors as strings.
+void mp_command_batch_error_strings(struct mpv_node *result)
+{
+    if (result->format != MPV_FORMAT_NODE_ARRAY)
+        return;
+    for (int n = 0; n < result->u.list->num; n++) {
+        struct mpv_node *err = node_map_get(&result->u.list->values[n], "error");
+        err->format = MPV_FORMAT_STRING;
+        err->u.string = (char *)mpv_error_string(err->u.int64);
+    }
+}
+
 struct getproperty_request {
     struct MPContext *mpctx;
     const char *name;
@@ -1532,6 +1695,13 @@ static void property_free(void *p)
 
 int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
                          const char *name, mpv_format format)
+{
+    return mpv_observe_property_ex(ctx, userdata, name, format, 0, 0);
+}
+
+int mpv_observe_property_ex(mpv_handle *ctx, uint64_t userdata,
+                            const char *name, mpv_format format,
+                            double min_interval, double min_delta)
 {
     const struct m_option *type = get_mp_type_get(format);
     if (format != MPV_FORMAT_NONE && !type)
@@ -1539,6 +1709,8 @@ int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
     // Explicitly disallow this, because it would require a special code path.
     if (format == MPV_FORMAT_OSD_STRING)
         return MPV_ERROR_PROPERTY_FORMAT;
+    if (!(min_interval >= 0 && min_interval <= 3600) || !(min_delta >= 0))
+        return MPV_ERROR_INVALID_PARAMETER;
 
     pthread_mutex_lock(&ctx->lock);
     assert(!ctx->destroying);
@@ -1552,12 +1724,14 @@ int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
         .reply_id = userdata,
         .format = format,
         .type = type,
+        .min_interval_us = min_interval * 1e6,
+        .min_delta = min_delta,
         .change_ts = 1, // force initial event
         .refcount = 1,
     };
     ctx->properties_change_ts += 1;
     MP_TARRAY_APPEND(ctx, ctx->properties, ctx->num_properties, prop);
-    ctx->property_event_masks |= prop->event_mask;
+    atomic_fetch_or(&ctx->property_event_masks, prop->event_mask);
     ctx->new_property_events = true;
     ctx->cur_property_index = 0;
     ctx->has_pending_properties = true;
@@ -1586,8 +1760,98 @@ int mpv_unobserve_property(mpv_handle *ctx, uint64_t userdata)
     return count;
 }
 
-// Broadcast that a property has changed.
-void mp_client_property_change(struct MPContext *mpctx, const char *name)
+static void free_snapshot_entry(struct prop_snapshot *e)
+{
+    if (e->status >= 0)
+        m_option_free(get_mp_type_get(e->format), &e->value);
+    talloc_free(e->name);
+}
+
+// Call with clients->lock held.
+static void clear_snapshot(struct mp_client_api *clients)
+{
+    for (int n = 0; n < clients->num_snapshot; n++)
+        free_snapshot_entry(&clients->snapshot[n]);
+    clients->num_snapshot = 0;
+}
+
+// Remove all snapshot entries for the given property (in any format).
+// Call with clients->lock held.
+static void drop_snapshot(struct mp_client_api *clients, const char *name)
+{
+    for (int n = clients->num_snapshot - 1; n >= 0; n--) {
+        if (strcmp(clients->snapshot[n].name, name) == 0) {
+            free_snapshot_entry(&clients->snapshot[n]);
+            MP_TARRAY_REMOVE_AT(clients->snapshot, clients->num_snapshot, n);
+        }
+    }
+}
+
+// Call with clients->lock held.
+static struct prop_snapshot *find_snapshot(struct mp_client_api *clients,
+                                           const char *name, mpv_format format)
+{
+    for (int n = 0; n < clients->num_snapshot; n++) {
+        struct prop_snapshot *e = &clients->snapshot[n];
+        if (e->format == format && strcmp(e->name, name) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+// Call with clients->lock held. data is copied.
+static void add_snapshot(struct mp_client_api *clients, const char *name,
+                         mpv_format format, int status, void *data)
+{
+    struct prop_snapshot e = {
+        .name = talloc_strdup(NULL, name),
+        .format = format,
+        .status = status,
+    };
+    if (status >= 0)
+        m_option_copy(get_mp_type_get(format), &e.value, data);
+    MP_TARRAY_APPEND(clients, clients->snapshot, clients->num_snapshot, e);
+}
+
+// Read a property for the purpose of sending property change events. Each
+// property/format pair is read only once per mp_client_send_property_changes()
+// call, no matter how many clients observe it. On success, a copy of the value
+// is written to data. Call with no client API locks held.
+static int read_property_snapshot(struct MPContext *mpctx, const char *name,
+                                  mpv_format format, void *data)
+{
+    struct mp_client_api *clients = mpctx->clients;
+    const struct m_option *type = get_mp_type_get(format);
+
+    pthread_mutex_lock(&clients->lock);
+    struct prop_snapshot *e = find_snapshot(clients, name, format);
+    if (e) {
+        int status = e->status;
+        if (status >= 0)
+            m_option_copy(type, data, &e->value);
+        pthread_mutex_unlock(&clients->lock);
+        return status;
+    }
+    pthread_mutex_unlock(&clients->lock);
+
+    // Property getters may do anything, so the lock must not be held here.
+    struct getproperty_request req = {
+        .mpctx = mpctx,
+        .name = name,
+        .format = format,
+        .data = data,
+    };
+    getproperty_fn(&req);
+
+    pthread_mutex_lock(&clients->lock);
+    if (!find_snapshot(clients, name, format))
+        add_snapshot(clients, name, format, req.status, data);
+    pthread_mutex_unlock(&clients->lock);
+    return req.status;
+}
+
+static void mark_property_changed(struct MPContext *mpctx, const char *name,
+                                  bool drop_value)
 {
     struct mp_client_api *clients = mpctx->clients;
     int id = mp_get_property_id(mpctx, name);
@@ -1595,6 +1859,10 @@ void mp_client_property_change(struct MPContext *mpctx, const char *name)
 
     pthread_mutex_lock(&clients->lock);
 
+    // A snapshotted value would be stale now.
+    if (drop_value)
+        drop_snapshot(clients, name);
+
     for (int n = 0; n < clients->num_clients; n++) {
         struct mpv_handle *client = clients->clients[n];
         pthread_mutex_lock(&client->lock);
@@ -1618,6 +1886,30 @@ void mp_client_property_change(struct MPContext *mpctx, const char *name)
         mp_dispatch_adjust_timeout(mpctx->dispatch, 0);
 }
 
+// Broadcast that a property has changed.
+void mp_client_property_change(struct MPContext *mpctx, const char *name)
+{
+    mark_property_changed(mpctx, name, true);
+}
+
+// Broadcast that a property has changed, and provide its new value. Observers
+// which use the same format get the value directly, without calling the
+// property getter. The caller must guarantee that the value stays current
+// until the next mp_client_send_property_changes() call (i.e. any further
+// change must be notified again). data is copied.
+void mp_client_property_change_value(struct MPContext *mpctx, const char *name,
+                                     mpv_format format, void *data)
+{
+    struct mp_client_api *clients = mpctx->clients;
+
+    pthread_mutex_lock(&clients->lock);
+    drop_snapshot(clients, name);
+    add_snapshot(clients, name, format, 0, data);
+    pthread_mutex_unlock(&clients->lock);
+
+    mark_property_changed(mpctx, name, false);
+}
+
 // Mark properties as changed in reaction to specific events.
 // Called with ctx->lock held.
 static void notify_property_events(struct mpv_handle *ctx, int event)
@@ -1635,10 +1927,50 @@ static void notify_property_events(struct mpv_handle *ctx, int event)
         mp_dispatch_adjust_timeout(ctx->mpctx->dispatch, 0);
 }
 
+// Return whether the numeric values a and b differ by less than the delta
+// threshold set with mpv_observe_property_ex(). Non-numeric values never do.
+static bool below_min_delta(struct observe_property *prop, void *a, void *b)
+{
+    if (prop->min_delta <= 0)
+        return false;
+
+    double va, vb;
+    switch (prop->format) {
+    case MPV_FORMAT_INT64:
+        va = *(int64_t *)a;
+        vb = *(int64_t *)b;
+        break;
+    case MPV_FORMAT_DOUBLE:
+        va = *(double *)a;
+        vb = *(double *)b;
+        break;
+    case MPV_FORMAT_NODE: {
+        struct mpv_node *na = a, *nb = b;
+        if (na->format == MPV_FORMAT_INT64 && nb->format == MPV_FORMAT_INT64) {
+            va = na->u.int64;
+            vb = nb->u.int64;
+        } else if (na->format == MPV_FORMAT_DOUBLE &&
+                   nb->format == MPV_FORMAT_DOUBLE)
+        {
+            va = na->u.double_;
+            vb = nb->u.double_;
+        } else {
+            return false;
+        }
+        break;
+    }
+    default:
+        return false;
+    }
+
+    return fabs(va - vb) < prop->min_delta;
+}
+
 // Call with ctx->lock held (only). May temporarily drop the lock.
 static void send_client_property_changes(struct mpv_handle *ctx)
 {
     uint64_t cur_ts = ctx->properties_change_ts;
+    int64_t now = mp_time_us();
 
     ctx->has_pending_properties = false;
 
@@ -1648,25 +1980,35 @@ static void send_client_property_changes(struct mpv_handle *ctx)
         if (prop->value_ts == prop->change_ts)
             continue;
 
+        // Rate limited: don't even read the property until the interval has
+        // passed. The change is kept pending, and is picked up on the wakeup.
+        // Draining for hooks takes precedence.
+        if (prop->min_interval_us && prop->last_update_us &&
+            !prop->waiting_for_hook)
+        {
+            int64_t next = prop->last_update_us + prop->min_interval_us;
+            if (now < next) {
+                ctx->has_pending_properties = true;
+                mp_set_timeout(ctx->mpctx, (next - now) / 1e6);
+                continue;
+            }
+        }
+
         bool changed = false;
         if (prop->format) {
             const struct m_option *type = prop->type;
             union m_option_value val = {0};
-            struct getproperty_request req = {
-                .mpctx = ctx->mpctx,
-                .name = prop->name,
-                .format = prop->format,
-                .data = &val,
-            };
 
             // Temporarily unlock and read the property. The very important
             // thing is that property getters can do whatever they want, _and_
             // that they may wait on the client API user thread (if vo_libmpv
-            // or similar things are involved).
+            // or similar things are involved). The value is shared with other
+            // clients observing the same property.
             prop->refcount += 1; // keep prop alive (esp. prop->name)
             ctx->async_counter += 1; // keep ctx alive
             pthread_mutex_unlock(&ctx->lock);
-            getproperty_fn(&req);
+            int status = read_property_snapshot(ctx->mpctx, prop->name,
+                                                prop->format, &val);
             pthread_mutex_lock(&ctx->lock);
             ctx->async_counter -= 1;
             prop_unref(prop);
@@ -1681,10 +2023,13 @@ static void send_client_property_changes(struct mpv_handle *ctx)
             }
             assert(prop->refcount > 0);
 
-            bool val_valid = req.status >= 0;
+            bool val_valid = status >= 0;
             changed = prop->value_valid != val_valid;
             if (prop->value_valid && val_valid)
                 changed = !equal_mpv_value(&prop->value, &val, prop->format);
+            if (changed && val_valid && prop->value_valid &&
+                below_min_delta(prop, &prop->value, &val))
+                changed = false;
             if (prop->value_ts == 0)
                 changed = true; // initial event
 
@@ -1711,6 +2056,7 @@ static void send_client_property_changes(struct mpv_handle *ctx)
             prop->waiting_for_hook = false;
         } else {
             ctx->new_property_events = true;
+            prop->last_update_us = now;
         }
 
         prop->value_ts = prop->change_ts;
@@ -1747,6 +2093,7 @@ void mp_client_send_property_changes(struct MPContext *mpctx)
         }
     }
 
+    clear_snapshot(clients);
     pthread_mutex_unlock(&clients->lock);
 }
 
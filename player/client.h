@@ -30,6 +30,8 @@ int mp_client_send_event(struct MPContext *mpctx, const char *client_name,
 int mp_client_send_event_dup(struct MPContext *mpctx, const char *client_name,
                              int event, void *data);
 void mp_client_property_change(struct MPContext *mpctx, const char *name);
+void mp_client_property_change_value(struct MPContext *mpctx, const char *name,
+                                     mpv_format format, void *data);
 void mp_client_send_property_changes(struct MPContext *mpctx);
 
 struct mpv_handle *mp_new_client(struct mp_client_api *clients, const char *name);
@@ -40,6 +42,8 @@ struct mpv_global *mp_client_get_global(struct mpv_handle *ctx);
 void mp_client_broadcast_event_external(struct mp_client_api *api, int event,
                                         void *data);
 
+void mp_command_batch_error_strings(struct mpv_node *result);
+
 // m_option.c
 void *node_get_alloc(struct mpv_node *node);
 
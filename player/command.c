@@ -81,6 +81,7 @@
 struct command_ctx {
     // All properties, terminated with a {0} item.
     struct m_property *properties;
+    struct m_property_list property_list; // for lookup in properties
 
     double last_seek_time;
     double last_seek_pts;
@@ -1729,6 +1730,24 @@ static int mp_property_audio_devices(void *ctx, struct m_property *prop,
                                 get_device_entry, list);
 }
 
+static int mp_property_ao_buffer(void *ctx, struct m_property *prop,
+                                 int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (!mpctx->ao)
+        return M_PROPERTY_UNAVAILABLE;
+
+    struct ao_buffer_stats s;
+    ao_get_buffer_stats(mpctx->ao, &s);
+
+    const char *name = prop->priv;
+    if (strcmp(name, "latency") == 0)
+        return m_property_double_ro(action, arg, s.latency);
+    if (strcmp(name, "buffer-size") == 0)
+        return m_property_double_ro(action, arg, s.buffer_size);
+    return m_property_int_ro(action, arg, s.underruns);
+}
+
 static int mp_property_ao(void *ctx, struct m_property *p, int action, void *arg)
 {
     MPContext *mpctx = ctx;
@@ -3643,6 +3662,9 @@ static const struct m_property mp_properties_base[] = {
     {"audio-device", mp_property_audio_device},
     {"audio-device-list", mp_property_audio_devices},
     {"current-ao", mp_property_ao},
+    {"ao-latency", mp_property_ao_buffer, .priv = "latency"},
+    {"ao-buffer-size", mp_property_ao_buffer, .priv = "buffer-size"},
+    {"ao-underruns", mp_property_ao_buffer, .priv = "underruns"},
 
     // Video
     {"video-out-params", mp_property_vo_imgparams},
@@ -3781,7 +3803,8 @@ static const char *const *const mp_event_property_change[] = {
       "estimated-display-fps", "vsync-jitter", "sub-text", "secondary-sub-text",
       "audio-bitrate", "video-bitrate", "sub-bitrate", "decoder-frame-drop-count",
       "frame-drop-count", "video-frame-info", "vf-metadata", "af-metadata",
-      "sub-start", "sub-end", "secondary-sub-start", "secondary-sub-end"),
+      "sub-start", "sub-end", "secondary-sub-start", "secondary-sub-end",
+      "ao-latency", "ao-buffer-size", "ao-underruns"),
     E(MP_EVENT_DURATION_UPDATE, "duration"),
     E(MPV_EVENT_VIDEO_RECONFIG, "video-out-params", "video-params",
       "video-format", "video-codec", "video-bitrate", "dwidth", "dheight",
@@ -3855,11 +3878,13 @@ uint64_t mp_get_property_event_mask(const char *name)
 int mp_get_property_id(struct MPContext *mpctx, const char *name)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    for (int n = 0; ctx->properties[n].name; n++) {
-        if (match_property(ctx->properties[n].name, name))
-            return n;
-    }
-    return -1;
+    // Same as match_property(): "options/name" and "name/sub" map to "name".
+    if (strncmp(name, "options/", 8) == 0)
+        name += 8;
+    char base[128];
+    snprintf(base, sizeof(base), "%.*s", (int)strcspn(name, "/"), name);
+    struct m_property *prop = m_property_list_find(&ctx->property_list, base);
+    return prop ? prop - ctx->properties : -1;
 }
 
 static bool is_property_set(int action, void *val)
@@ -3884,7 +3909,7 @@ int mp_property_do(const char *name, int action, void *val,
                    struct MPContext *ctx)
 {
     struct command_ctx *cmd = ctx->command_ctx;
-    int r = m_property_do(ctx->log, cmd->properties, name, action, val, ctx);
+    int r = m_property_do(ctx->log, &cmd->property_list, name, action, val, ctx);
 
     if (mp_msg_test(ctx->log, MSGL_V) && is_property_set(action, val)) {
         struct m_option ot = {0};
@@ -3909,7 +3934,7 @@ int mp_property_do(const char *name, int action, void *val,
 char *mp_property_expand_string(struct MPContext *mpctx, const char *str)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    return m_properties_expand_string(ctx->properties, str, mpctx);
+    return m_properties_expand_string(&ctx->property_list, str, mpctx);
 }
 
 // Before expanding properties, parse C-style escapes like "\n"
@@ -6479,6 +6504,7 @@ void command_init(struct MPContext *mpctx)
     ctx->properties =
         talloc_zero_array(ctx, struct m_property, num_base + num_opts + 1);
     memcpy(ctx->properties, mp_properties_base, sizeof(mp_properties_base));
+    m_property_list_init(ctx, &ctx->property_list, ctx->properties, num_base);
 
     int count = num_base;
     for (int n = 0; n < num_opts; n++) {
@@ -6513,11 +6539,14 @@ void command_init(struct MPContext *mpctx)
         }
 
         // The option might be covered by a manual property already.
-        if (m_property_list_find(ctx->properties, prop.name))
+        // (property_list contains only mp_properties_base at this point.)
+        if (m_property_list_find(&ctx->property_list, prop.name))
             continue;
 
         ctx->properties[count++] = prop;
     }
+
+    m_property_list_init(ctx, &ctx->property_list, ctx->properties, count);
 }
 
 static void command_event(struct MPContext *mpctx, int event, void *arg)
@@ -6643,7 +6672,9 @@ void mp_option_change_callback(void *ctx, struct m_config_option *co, int flags,
     if (flags & UPDATE_INPUT)
         mp_input_update_opts(mpctx->input);
 
-    if (init || opt_ptr == &opts->ipc_path || opt_ptr == &opts->ipc_client) {
+    if (init || opt_ptr == &opts->ipc_path || opt_ptr == &opts->ipc_client ||
+        opt_ptr == &opts->ipc_multiplex)
+    {
         mp_uninit_ipc(mpctx->ipc_ctx);
         mpctx->ipc_ctx = mp_init_ipc(mpctx->clients, mpctx->global);
     }
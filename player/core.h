@@ -191,6 +191,10 @@ struct ao_chain {
     double start_pts;
     bool start_pts_known;
 
+    // First pts written while the AO was still playing the previous file
+    // (gapless), or MP_NOPTS_VALUE.
+    double gapless_start_pts;
+
     struct track *track;
     struct mp_pin *filter_src;
     struct mp_pin *dec_src;
@@ -310,6 +314,7 @@ typedef struct MPContext {
 
     struct ao *ao;
     struct mp_aframe *ao_filter_fmt; // for weak gapless audio check
+    bool ao_prebuffering; // ao_set_prebuffer() was enabled
     struct ao_chain *ao_chain;
 
     struct vo_chain *vo_chain;
@@ -431,6 +436,7 @@ typedef struct MPContext {
     struct mp_ipc_ctx *ipc_ctx;
 
     int64_t builtin_script_ids[5];
+    struct mp_script_executor *script_executor;
 
     pthread_mutex_t abort_lock;
 
@@ -490,6 +496,7 @@ void audio_update_balance(struct MPContext *mpctx);
 void audio_update_media_role(struct MPContext *mpctx);
 void reload_audio_output(struct MPContext *mpctx);
 void audio_start_ao(struct MPContext *mpctx);
+void audio_start_gapless_prebuffer(struct MPContext *mpctx);
 
 // configfiles.c
 void mp_parse_cfgfiles(struct MPContext *mpctx);
@@ -617,16 +624,28 @@ struct mp_script_args {
     struct mpv_handle *client;
     const char *filename;
     const char *path;
+    // If true, load() may set task_run to continue running the script as
+    // cooperative task on the shared script executor, instead of blocking
+    // until the script exits. task_run is then called on an executor thread
+    // on every client wakeup, or when the returned timeout (in seconds)
+    // expires. It returns <0 once the script has exited, after which
+    // task_destroy (if set) is called.
+    bool use_executor;
+    double (*task_run)(struct mp_script_args *args);
+    void (*task_destroy)(struct mp_script_args *args);
+    void *task_priv;
 };
 struct mp_scripting {
     const char *name;       // e.g. "lua script"
     const char *file_ext;   // e.g. "lua"
     bool no_thread;         // don't run load() on dedicated thread
+    bool tasks;             // supports mp_script_args.use_executor
     int (*load)(struct mp_script_args *args);
 };
 bool mp_load_scripts(struct MPContext *mpctx);
 void mp_load_builtin_scripts(struct MPContext *mpctx);
 int64_t mp_load_user_script(struct MPContext *mpctx, const char *fname);
+void mp_script_executor_destroy(struct MPContext *mpctx);
 
 // sub.c
 void reset_subtitle_state(struct MPContext *mpctx);
@@ -28,6 +28,9 @@
 #include <lualib.h>
 #include <lauxlib.h>
 
+#include <libavutil/sha.h>
+#include <libavutil/mem.h>
+
 #include "osdep/io.h"
 
 #include "mpv_talloc.h"
@@ -37,11 +40,13 @@
 #include "common/msg.h"
 #include "common/msg_control.h"
 #include "common/stats.h"
+#include "options/m_config.h"
 #include "options/m_option.h"
 #include "input/input.h"
 #include "options/path.h"
 #include "misc/bstr.h"
 #include "misc/json.h"
+#include "misc/random.h"
 #include "osdep/subprocess.h"
 #include "osdep/timer.h"
 #include "osdep/threads.h"
@@ -82,6 +87,21 @@ static const char * const builtin_lua_scripts[][2] = {
     {0}
 };
 
+struct lua_opts {
+    char *bytecode_cache_dir;
+};
+
+#define OPT_BASE_STRUCT struct lua_opts
+const struct m_sub_options lua_conf = {
+    .opts = (const struct m_option[]) {
+        {"lua-bytecode-cache-dir", OPT_STRING(bytecode_cache_dir),
+            .flags = M_OPT_FILE},
+        {0}
+    },
+    .size = sizeof(struct lua_opts),
+};
+#undef OPT_BASE_STRUCT
+
 // Represents a loaded script. Each has its own Lua state.
 struct script_ctx {
     const char *name;
@@ -95,11 +115,22 @@ struct script_ctx {
     lua_Alloc lua_allocf;
     void *lua_alloc_ud;
     struct stats_ctx *stats;
+    // Result of the last property getter call; see get_property_result().
+    mpv_node prop_result;
+    // Coroutine running the event loop, if on the shared script executor.
+    bool use_executor;
+    lua_State *task;
+    // Bytecode cache directory (NULL if disabled), and a string identifying
+    // the Lua implementation and its bytecode format.
+    char *cache_dir;
+    char *cache_impl;
+    int cache_hits, cache_misses;
 };
 
 #if LUA_VERSION_NUM <= 501
 #define mp_cpcall lua_cpcall
 #define mp_lua_len lua_objlen
+#define mp_lua_resume(L, narg) lua_resume(L, narg)
 #else
 // Curse whoever had this stupid idea. Curse whoever thought it would be a good
 // idea not to include an emulated lua_cpcall() even more.
@@ -110,6 +141,7 @@ static int mp_cpcall (lua_State *L, lua_CFunction func, void *ud)
     return lua_pcall(L, 1, 0, 0);
 }
 #define mp_lua_len lua_rawlen
+#define mp_lua_resume(L, narg) lua_resume(L, NULL, narg)
 #endif
 
 // Ensure that the given argument exists, even if it's nil. Can be used to
@@ -145,8 +177,8 @@ static void af_pushcclosure(lua_State *L, af_CFunction fn, int n);
 #define     af_pushcfunction(L, fn) af_pushcclosure((L), (fn), 0)
 
 
-// add_af_dir, add_af_mpv_alloc take a valid DIR*/char* value respectively,
-// and closedir/mpv_free it when the parent is freed.
+// add_af_dir takes a valid DIR* value, and closedir() it when the parent is
+// freed.
 
 static void destruct_af_dir(void *p)
 {
@@ -160,18 +192,6 @@ static void add_af_dir(void *parent, DIR *d)
     talloc_set_destructor(pd, destruct_af_dir);
 }
 
-static void destruct_af_mpv_alloc(void *p)
-{
-    mpv_free(*(char**)p);
-}
-
-static void add_af_mpv_alloc(void *parent, char *ma)
-{
-    char **p = talloc(parent, char*);
-    *p = ma;
-    talloc_set_destructor(p, destruct_af_mpv_alloc);
-}
-
 
 // Perform the equivalent of mpv_free_node_contents(node) when tmp is freed.
 static void steal_node_alloctions(void *tmp, mpv_node *node)
@@ -244,6 +264,120 @@ static int check_error(lua_State *L, int err)
 
 static void add_functions(struct script_ctx *ctx);
 
+static void init_bytecode_cache(struct script_ctx *ctx)
+{
+    lua_State *L = ctx->state;
+    void *tmp = talloc_new(NULL);
+
+    struct lua_opts *opts = mp_get_config_group(tmp, ctx->mpctx->global,
+                                                &lua_conf);
+    if (opts->bytecode_cache_dir && opts->bytecode_cache_dir[0]) {
+        ctx->cache_dir = mp_get_user_path(ctx, ctx->mpctx->global,
+                                          opts->bytecode_cache_dir);
+
+        // LuaJIT claims to be Lua 5.1, but has its own bytecode format, which
+        // also depends on the target architecture.
+        ctx->cache_impl = talloc_asprintf(ctx, "%s/%d/%d/%d",
+                                          LUA_RELEASE, (int)sizeof(void *),
+                                          (int)sizeof(size_t),
+                                          (int)sizeof(lua_Number));
+        lua_getglobal(L, "jit"); // jit
+        if (lua_istable(L, -1)) {
+            lua_getfield(L, -1, "version"); // jit version
+            lua_getfield(L, -2, "arch"); // jit version arch
+            const char *ver = lua_tostring(L, -2);
+            const char *arch = lua_tostring(L, -1);
+            ctx->cache_impl = talloc_asprintf_append(ctx->cache_impl, "/%s/%s",
+                                                     ver ? ver : "?",
+                                                     arch ? arch : "?");
+            lua_pop(L, 2); // jit
+        }
+        lua_pop(L, 1); // -
+    }
+
+    talloc_free(tmp);
+}
+
+static int write_bytecode(lua_State *L, const void *p, size_t sz, void *ud)
+{
+    struct bstr *buf = ud;
+    bstr_xappend(NULL, buf, (bstr){(unsigned char *)p, sz});
+    return 0;
+}
+
+static const char cache_header[] = "mpv lua bytecode cache v1\n";
+
+// Like luaL_loadbuffer(), but if the bytecode cache is enabled, try to load the
+// compiled chunk from it, or add it to the cache. Cache entries are keyed by a
+// hash of the source, the chunk name and the Lua implementation, so changing
+// any of them simply results in a new cache entry.
+static int load_buffer(lua_State *L, const char *buf, size_t len,
+                       const char *name)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    if (!ctx->cache_dir)
+        return luaL_loadbuffer(L, buf, len, name);
+
+    void *tmp = talloc_new(NULL);
+
+    struct AVSHA *sha = av_sha_alloc();
+    MP_HANDLE_OOM(sha);
+    av_sha_init(sha, 256);
+    av_sha_update(sha, ctx->cache_impl, strlen(ctx->cache_impl) + 1);
+    av_sha_update(sha, name, strlen(name) + 1);
+    av_sha_update(sha, buf, len);
+    uint8_t hash[256 / 8];
+    av_sha_final(sha, hash);
+    av_free(sha);
+
+    char hashstr[256 / 8 * 2 + 1];
+    for (int n = 0; n < 256 / 8; n++)
+        snprintf(hashstr + n * 2, sizeof(hashstr) - n * 2, "%02X", hash[n]);
+    char *cache_file = mp_path_join(tmp, ctx->cache_dir, hashstr);
+
+    if (stat(cache_file, &(struct stat){0}) == 0) {
+        bstr data = stream_read_file(cache_file, tmp, ctx->mpctx->global,
+                                     100000000);
+        if (bstr_eatstart0(&data, cache_header)) {
+            if (luaL_loadbuffer(L, data.start, data.len, name) == 0) {
+                ctx->cache_hits++;
+                talloc_free(tmp);
+                return 0;
+            }
+            lua_pop(L, 1); // -
+        }
+        MP_WARN(ctx, "Ignoring invalid bytecode cache file: %s\n", cache_file);
+    }
+
+    int r = luaL_loadbuffer(L, buf, len, name);
+    if (r) {
+        talloc_free(tmp);
+        return r;
+    }
+    ctx->cache_misses++;
+
+    bstr code = {0};
+    bstr_xappend(tmp, &code, bstr0(cache_header));
+    if (lua_dump(L, write_bytecode, &code) == 0) {
+        // Write to a temporary file first, so that concurrently starting
+        // instances never see a partially written cache file.
+        mp_mkdirp(ctx->cache_dir);
+        char *tmp_file = talloc_asprintf(tmp, "%s.%"PRIx64".tmp", cache_file,
+                                         mp_rand_next());
+        MP_DBG(ctx, "Writing bytecode cache file: %s\n", cache_file);
+        FILE *out = fopen(tmp_file, "wb");
+        if (out) {
+            bool ok = fwrite(code.start, code.len, 1, out) == 1;
+            ok &= fclose(out) == 0;
+            if (!ok || rename(tmp_file, cache_file))
+                unlink(tmp_file);
+        }
+    }
+
+    talloc_free(tmp);
+    return 0;
+}
+
 static void load_file(lua_State *L, const char *fname)
 {
     struct script_ctx *ctx = get_ctx(L);
@@ -254,7 +388,7 @@ static void load_file(lua_State *L, const char *fname)
     struct bstr s = stream_read_file(fname, tmp, ctx->mpctx->global, 100000000);
     if (!s.start)
         luaL_error(L, "Could not read file.\n");
-    if (luaL_loadbuffer(L, s.start, s.len, dispname))
+    if (load_buffer(L, s.start, s.len, dispname))
         lua_error(L);
     lua_call(L, 0, 1);
     talloc_free(tmp);
@@ -268,7 +402,7 @@ static int load_builtin(lua_State *L)
     for (int n = 0; builtin_lua_scripts[n][0]; n++) {
         if (strcmp(name, builtin_lua_scripts[n][0]) == 0) {
             const char *script = builtin_lua_scripts[n][1];
-            if (luaL_loadbuffer(L, script, strlen(script), dispname))
+            if (load_buffer(L, script, strlen(script), dispname))
                 lua_error(L);
             lua_call(L, 0, 1);
             return 1;
@@ -312,19 +446,45 @@ static int load_scripts(lua_State *L)
 {
     struct script_ctx *ctx = get_ctx(L);
     const char *fname = ctx->filename;
+    int64_t start = mp_time_us();
 
     require(L, "mp.defaults");
 
+    lua_getglobal(L, "mp_event_loop"); // default_loop
+
     if (fname[0] == '@') {
         require(L, fname);
     } else {
         load_file(L, fname);
     }
 
-    lua_getglobal(L, "mp_event_loop"); // fn
+    double load_time = (mp_time_us() - start) / 1e6;
+    stats_value(ctx->stats, "load-time", load_time);
+    MP_STATS(ctx, "value %f script-load/%s", load_time, ctx->name);
+    if (ctx->cache_dir) {
+        MP_VERBOSE(ctx, "Loaded in %.3f ms (%d chunks from bytecode cache, "
+                   "%d compiled).\n", load_time * 1e3, ctx->cache_hits,
+                   ctx->cache_misses);
+    } else {
+        MP_VERBOSE(ctx, "Loaded in %.3f ms.\n", load_time * 1e3);
+    }
+
+    lua_getglobal(L, "mp_event_loop"); // default_loop fn
     if (lua_isnil(L, -1))
         luaL_error(L, "no event loop function\n");
-    lua_call(L, 0, 0); // -
+
+    // Scripts with their own event loop keep blocking this thread.
+    if (ctx->use_executor && lua_rawequal(L, -1, -2)) {
+        lua_State *co = lua_newthread(L); // default_loop fn co
+        lua_setfield(L, LUA_REGISTRYINDEX, "task"); // default_loop fn
+        push_module_table(L, "mp"); // default_loop fn mp
+        lua_getfield(L, -1, "_task_event_loop"); // default_loop fn mp task_loop
+        lua_xmove(L, co, 1); // default_loop fn mp
+        ctx->task = co;
+        return 0;
+    }
+
+    lua_call(L, 0, 0); // default_loop
 
     return 0;
 }
@@ -423,6 +583,9 @@ static int run_lua(lua_State *L)
     fuck_lua(L, "cpath", NULL);
     assert(lua_gettop(L) == 0);
 
+    init_bytecode_cache(ctx);
+    assert(lua_gettop(L) == 0);
+
     // run this under an error handler that can do backtraces
     lua_pushcfunction(L, error_handler); // errf
     lua_pushcfunction(L, load_scripts); // errf fn
@@ -434,6 +597,51 @@ static int run_lua(lua_State *L)
     return 0;
 }
 
+static void destroy_lua(struct script_ctx *ctx)
+{
+    if (ctx->state)
+        lua_close(ctx->state);
+    mpv_free_node_contents(&ctx->prop_result);
+    talloc_free(ctx);
+}
+
+// Run the event loop coroutine until it waits for new events again.
+static double run_lua_task(struct mp_script_args *args)
+{
+    struct script_ctx *ctx = args->task_priv;
+    lua_State *L = ctx->state;
+    lua_State *co = ctx->task;
+
+    int r = mp_lua_resume(co, 0);
+    if (r == LUA_YIELD) {
+        double timeout = lua_tonumber(co, -1);
+        lua_settop(co, 0);
+        return MPMAX(timeout, 0);
+    }
+
+    if (r) {
+        const char *e = lua_tostring(co, -1);
+        if (luaL_loadstring(L, "return debug.traceback(...)") == 0) { // fn
+            lua_pushthread(co);
+            lua_xmove(co, L, 1); // fn co
+            lua_pushstring(L, ""); // fn co ""
+            if (lua_pcall(L, 2, 1, 0) == 0) { // backtrace
+                const char *tr = lua_tostring(L, -1);
+                MP_WARN(ctx, "%s\n", tr ? tr : "(unknown)");
+            }
+        }
+        lua_settop(L, 0);
+        MP_FATAL(ctx, "Lua error: %s\n", e ? e : "(unknown)");
+    }
+
+    return -1;
+}
+
+static void destroy_lua_task(struct mp_script_args *args)
+{
+    destroy_lua(args->task_priv);
+}
+
 static int load_lua(struct mp_script_args *args)
 {
     int r = -1;
@@ -448,9 +656,12 @@ static int load_lua(struct mp_script_args *args)
         .path = args->path,
         .stats = stats_ctx_create(ctx, args->mpctx->global,
                     mp_tprintf(80, "script/%s", mpv_client_name(args->client))),
+        .use_executor = args->use_executor,
     };
 
-    stats_register_thread_cputime(ctx->stats, "cpu");
+    // Tasks on the executor don't own a thread.
+    if (!ctx->use_executor)
+        stats_register_thread_cputime(ctx->stats, "cpu");
 
     if (LUA_VERSION_NUM != 501 && LUA_VERSION_NUM != 502) {
         MP_FATAL(ctx, "Only Lua 5.1 and 5.2 are supported.\n");
@@ -475,12 +686,17 @@ static int load_lua(struct mp_script_args *args)
         goto error_out;
     }
 
+    if (ctx->task) {
+        args->task_run = run_lua_task;
+        args->task_destroy = destroy_lua_task;
+        args->task_priv = ctx;
+        return 0;
+    }
+
     r = 0;
 
 error_out:
-    if (ctx->state)
-        lua_close(ctx->state);
-    talloc_free(ctx);
+    destroy_lua(ctx);
     return r;
 }
 
@@ -787,17 +1003,29 @@ static int script_set_property_native(lua_State *L, void *tmp)
 
 }
 
-static int script_get_property_base(lua_State *L, void *tmp, int is_osd)
+// Property getters are called very often (e.g. by the OSC on every redraw),
+// and the overhead of autofree functions dominates for simple values. Instead,
+// they read the property into ctx->prop_result, which is freed right after
+// the value is pushed. If pushing fails with a Lua error, it's freed on the
+// next call or when the script exits.
+static mpv_node *get_property_result(struct script_ctx *ctx)
+{
+    mpv_free_node_contents(&ctx->prop_result);
+    return &ctx->prop_result;
+}
+
+static int script_get_property_base(lua_State *L, int is_osd)
 {
     struct script_ctx *ctx = get_ctx(L);
     const char *name = luaL_checkstring(L, 1);
     int type = is_osd ? MPV_FORMAT_OSD_STRING : MPV_FORMAT_STRING;
 
-    char *result = NULL;
-    int err = mpv_get_property(ctx->client, name, type, &result);
+    mpv_node *res = get_property_result(ctx);
+    int err = mpv_get_property(ctx->client, name, type, &res->u.string);
     if (err >= 0) {
-        add_af_mpv_alloc(tmp, result);
-        lua_pushstring(L, result);
+        res->format = MPV_FORMAT_STRING;
+        lua_pushstring(L, res->u.string);
+        mpv_free_node_contents(res);
         return 1;
     } else {
         if (lua_isnoneornil(L, 2) && type == MPV_FORMAT_OSD_STRING) {
@@ -810,14 +1038,14 @@ static int script_get_property_base(lua_State *L, void *tmp, int is_osd)
     }
 }
 
-static int script_get_property(lua_State *L, void *tmp)
+static int script_get_property(lua_State *L)
 {
-    return script_get_property_base(L, tmp, 0);
+    return script_get_property_base(L, 0);
 }
 
-static int script_get_property_osd(lua_State *L, void *tmp)
+static int script_get_property_osd(lua_State *L)
 {
-    return script_get_property_base(L, tmp, 1);
+    return script_get_property_base(L, 1);
 }
 
 static int script_get_property_bool(lua_State *L)
@@ -876,7 +1104,7 @@ static void pushnode(lua_State *L, mpv_node *node)
         lua_pushboolean(L, node->u.flag);
         break;
     case MPV_FORMAT_NODE_ARRAY:
-        lua_newtable(L); // table
+        lua_createtable(L, node->u.list->num, 0); // table
         lua_getfield(L, LUA_REGISTRYINDEX, "ARRAY"); // table mt
         lua_setmetatable(L, -2); // table
         for (int n = 0; n < node->u.list->num; n++) {
@@ -885,7 +1113,7 @@ static void pushnode(lua_State *L, mpv_node *node)
         }
         break;
     case MPV_FORMAT_NODE_MAP:
-        lua_newtable(L); // table
+        lua_createtable(L, 0, node->u.list->num); // table
         lua_getfield(L, LUA_REGISTRYINDEX, "MAP"); // table mt
         lua_setmetatable(L, -2); // table
         for (int n = 0; n < node->u.list->num; n++) {
@@ -907,17 +1135,17 @@ static void pushnode(lua_State *L, mpv_node *node)
     }
 }
 
-static int script_get_property_native(lua_State *L, void *tmp)
+static int script_get_property_native(lua_State *L)
 {
     struct script_ctx *ctx = get_ctx(L);
     const char *name = luaL_checkstring(L, 1);
     mp_lua_optarg(L, 2);
 
-    mpv_node node;
-    int err = mpv_get_property(ctx->client, name, MPV_FORMAT_NODE, &node);
+    mpv_node *res = get_property_result(ctx);
+    int err = mpv_get_property(ctx->client, name, MPV_FORMAT_NODE, res);
     if (err >= 0) {
-        steal_node_alloctions(tmp, &node);
-        pushnode(L, &node);
+        pushnode(L, res);
+        mpv_free_node_contents(res);
         return 1;
     }
     lua_pushvalue(L, 2);
@@ -976,6 +1204,27 @@ static int script_command_native(lua_State *L, void *tmp)
     return 2;
 }
 
+static int script_command_batch(lua_State *L, void *tmp)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    struct mpv_node node;
+    struct mpv_node result;
+    makenode(tmp, &node, L, 1);
+    int err = mpv_command_batch(ctx->client, &node, &result);
+    if (result.format != MPV_FORMAT_NODE_ARRAY) {
+        lua_pushnil(L);
+        lua_pushstring(L, mpv_error_string(err));
+        return 2;
+    }
+    steal_node_alloctions(tmp, &result);
+    mp_command_batch_error_strings(&result);
+    pushnode(L, &result);
+    if (err >= 0)
+        return 1;
+    lua_pushstring(L, mpv_error_string(err));
+    return 2;
+}
+
 static int script_raw_command_native_async(lua_State *L, void *tmp)
 {
     struct script_ctx *ctx = get_ctx(L);
@@ -1155,7 +1404,7 @@ static int script_parse_json(lua_State *L, void *tmp)
     bool trail = lua_toboolean(L, 2);
     bool ok = false;
     struct mpv_node node;
-    if (json_parse(tmp, &node, &text, 32) >= 0) {
+    if (json_parse(talloc_new_arena(tmp), &node, &text, 32) >= 0) {
         json_skip_whitespace(&text);
         ok = !text[0] || trail;
     }
@@ -1212,13 +1461,14 @@ static const struct fn_entry main_fns[] = {
     FN_ENTRY(command),
     FN_ENTRY(commandv),
     AF_ENTRY(command_native),
+    AF_ENTRY(command_batch),
     AF_ENTRY(raw_command_native_async),
     FN_ENTRY(raw_abort_async_command),
-    AF_ENTRY(get_property),
-    AF_ENTRY(get_property_osd),
+    FN_ENTRY(get_property),
+    FN_ENTRY(get_property_osd),
     FN_ENTRY(get_property_bool),
     FN_ENTRY(get_property_number),
-    AF_ENTRY(get_property_native),
+    FN_ENTRY(get_property_native),
     FN_ENTRY(set_property),
     FN_ENTRY(set_property_bool),
     FN_ENTRY(set_property_number),
@@ -1329,5 +1579,6 @@ static void add_functions(struct script_ctx *ctx)
 const struct mp_scripting mp_scripting_lua = {
     .name = "lua script",
     .file_ext = "lua",
+    .tasks = true,
     .load = load_lua,
 };
@@ -516,7 +516,9 @@ mp.use_suspend = false
 
 local suspend_warned = false
 
-function mp.dispatch_events(allow_wait)
+-- If yield is set, yield to the caller (the shared script executor) instead of
+-- blocking in mp.wait_event(). The yielded value is the wait timeout.
+local function dispatch_events(allow_wait, yield)
     local more_events = true
     if mp.use_suspend then
         if not suspend_warned then
@@ -546,6 +548,10 @@ function mp.dispatch_events(allow_wait)
                 return
             end
         end
+        if yield and wait ~= 0 then
+            coroutine.yield(wait)
+            wait = 0
+        end
         local e = mp.wait_event(wait)
         more_events = false
         if e.event ~= "none" then
@@ -555,6 +561,15 @@ function mp.dispatch_events(allow_wait)
     end
 end
 
+function mp.dispatch_events(allow_wait)
+    dispatch_events(allow_wait, false)
+end
+
+-- Run by the shared script executor instead of mp_event_loop().
+function mp._task_event_loop()
+    dispatch_events(true, true)
+end
+
 mp.register_idle(mp.flush_keybindings)
 
 -- additional helpers
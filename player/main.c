@@ -159,6 +159,7 @@ void mp_print_version(struct mp_log *log, int always)
 void mp_destroy(struct MPContext *mpctx)
 {
     mp_shutdown_clients(mpctx);
+    mp_script_executor_destroy(mpctx);
 
     mp_uninit_ipc(mpctx->ipc_ctx);
     mpctx->ipc_ctx = NULL;
@@ -143,6 +143,9 @@ void update_core_idle_state(struct MPContext *mpctx)
 
         update_screensaver_state(mpctx);
 
+        int idle = !active;
+        mp_client_property_change_value(mpctx, "core-idle", MPV_FORMAT_FLAG,
+                                        &idle);
         mp_notify(mpctx, MP_EVENT_CORE_IDLE, NULL);
     }
 }
@@ -782,8 +785,10 @@ static void handle_update_cache(struct MPContext *mpctx)
         force_update = true;
     }
 
-    if (s.eof && !busy)
+    if (s.eof && !busy) {
         prefetch_next(mpctx);
+        audio_start_gapless_prebuffer(mpctx);
+    }
 
     if (force_update) {
         mpctx->cache_update_pts = mpctx->playback_pts;
@@ -1079,6 +1084,17 @@ static void handle_playback_time(struct MPContext *mpctx)
                mpctx->audio_status < STATUS_EOF)
     {
         mpctx->playback_pts = playing_audio_pts(mpctx);
+        // In the gapless case, the AO delay includes the audio of the previous
+        // file that is still queued (up to --gapless-audio-prebuffer). Don't
+        // report a position before the start of this file until it's played.
+        struct ao_chain *ao_c = mpctx->ao_chain;
+        if (ao_c && ao_c->gapless_start_pts != MP_NOPTS_VALUE) {
+            if (mpctx->playback_pts < ao_c->gapless_start_pts) {
+                mpctx->playback_pts = ao_c->gapless_start_pts;
+            } else {
+                ao_c->gapless_start_pts = MP_NOPTS_VALUE;
+            }
+        }
     } else if (mpctx->video_status == STATUS_EOF &&
                mpctx->audio_status == STATUS_EOF)
     {
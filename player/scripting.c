@@ -29,6 +29,7 @@
 #include "osdep/io.h"
 #include "osdep/subprocess.h"
 #include "osdep/threads.h"
+#include "osdep/timer.h"
 
 #include "common/common.h"
 #include "common/msg.h"
@@ -37,6 +38,7 @@
 #include "options/parse_configfile.h"
 #include "options/path.h"
 #include "misc/bstr.h"
+#include "misc/thread_pool.h"
 #include "core.h"
 #include "client.h"
 #include "libmpv/client.h"
@@ -81,6 +83,184 @@ static char *script_name_from_filename(void *talloc_ctx, const char *fname)
     return talloc_asprintf(talloc_ctx, "%s", name);
 }
 
+// Shared executor for scripts that run as cooperative tasks (see
+// --script-executor-threads). A single dispatcher thread watches wakeups and
+// timeouts of all tasks, and runs due tasks on a small thread pool. Each task
+// still has its own client handle and script state; only threads are shared.
+struct mp_script_executor {
+    struct mp_thread_pool *pool;
+    pthread_t dispatcher;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    bool terminate;
+    struct script_task **tasks;
+    int num_tasks;
+};
+
+struct script_task {
+    struct mp_script_executor *ex;
+    struct mp_script_args *arg;
+    // -- protected by ex->lock
+    int64_t deadline;   // mp_time_us() time to run task_run() again
+    bool running;       // queued on or running in the thread pool
+    bool wakeup;        // client wakeup since task_run() was last called
+};
+
+static void destroy_script(struct mp_script_args *arg)
+{
+    if (arg->task_destroy)
+        arg->task_destroy(arg);
+    mpv_destroy(arg->client);
+    talloc_free(arg);
+}
+
+static void run_task(void *p)
+{
+    struct script_task *task = p;
+    struct mp_script_executor *ex = task->ex;
+    struct mp_script_args *arg = task->arg;
+
+    double timeout = arg->task_run(arg);
+
+    if (timeout < 0) {
+        // Make sure the callback is not running and won't be called anymore.
+        mpv_set_wakeup_callback(arg->client, NULL, NULL);
+        pthread_mutex_lock(&ex->lock);
+        for (int n = 0; n < ex->num_tasks; n++) {
+            if (ex->tasks[n] == task) {
+                MP_TARRAY_REMOVE_AT(ex->tasks, ex->num_tasks, n);
+                break;
+            }
+        }
+        pthread_cond_signal(&ex->wakeup);
+        pthread_mutex_unlock(&ex->lock);
+        talloc_free(task);
+        destroy_script(arg);
+        return;
+    }
+
+    pthread_mutex_lock(&ex->lock);
+    task->deadline = mp_add_timeout(mp_time_us(), timeout);
+    task->running = false;
+    pthread_cond_signal(&ex->wakeup);
+    pthread_mutex_unlock(&ex->lock);
+}
+
+static void *dispatcher_thread(void *p)
+{
+    struct mp_script_executor *ex = p;
+    mpthread_set_name("script executor");
+
+    pthread_mutex_lock(&ex->lock);
+    while (!ex->terminate) {
+        int64_t now = mp_time_us();
+        int64_t next = INT64_MAX;
+        for (int n = 0; n < ex->num_tasks; n++) {
+            struct script_task *task = ex->tasks[n];
+            if (task->running)
+                continue;
+            if (task->wakeup || task->deadline <= now) {
+                task->running = true;
+                task->wakeup = false;
+                mp_thread_pool_queue(ex->pool, run_task, task);
+            } else {
+                next = MPMIN(next, task->deadline);
+            }
+        }
+        struct timespec ts = mp_time_us_to_timespec(next);
+        pthread_cond_timedwait(&ex->wakeup, &ex->lock, &ts);
+    }
+    pthread_mutex_unlock(&ex->lock);
+
+    return NULL;
+}
+
+// Called by the client API with internal locks held; must not call it back.
+static void wakeup_task(void *p)
+{
+    struct script_task *task = p;
+    struct mp_script_executor *ex = task->ex;
+
+    pthread_mutex_lock(&ex->lock);
+    task->wakeup = true;
+    if (!task->running)
+        pthread_cond_signal(&ex->wakeup);
+    pthread_mutex_unlock(&ex->lock);
+}
+
+static void executor_destroy(void *p)
+{
+    struct mp_script_executor *ex = p;
+
+    pthread_mutex_lock(&ex->lock);
+    assert(ex->num_tasks == 0);
+    ex->terminate = true;
+    pthread_cond_signal(&ex->wakeup);
+    pthread_mutex_unlock(&ex->lock);
+    pthread_join(ex->dispatcher, NULL);
+
+    talloc_free(ex->pool); // waits until finished tasks are cleaned up
+    pthread_cond_destroy(&ex->wakeup);
+    pthread_mutex_destroy(&ex->lock);
+}
+
+static struct mp_script_executor *get_executor(struct MPContext *mpctx)
+{
+    if (mpctx->script_executor)
+        return mpctx->script_executor;
+
+    int threads = mpctx->opts->script_executor_threads;
+    if (threads < 1)
+        return NULL;
+
+    struct mp_script_executor *ex = talloc_zero(NULL, struct mp_script_executor);
+    ex->pool = mp_thread_pool_create(ex, 1, 1, threads);
+    if (!ex->pool) {
+        talloc_free(ex);
+        return NULL;
+    }
+    pthread_mutex_init(&ex->lock, NULL);
+    pthread_cond_init(&ex->wakeup, NULL);
+    if (pthread_create(&ex->dispatcher, NULL, dispatcher_thread, ex)) {
+        pthread_cond_destroy(&ex->wakeup);
+        pthread_mutex_destroy(&ex->lock);
+        talloc_free(ex);
+        return NULL;
+    }
+    talloc_set_destructor(ex, executor_destroy);
+
+    MP_VERBOSE(mpctx, "Running scripts on %d shared threads.\n", threads);
+    mpctx->script_executor = ex;
+    return ex;
+}
+
+// Must be called after all clients have been destroyed.
+void mp_script_executor_destroy(struct MPContext *mpctx)
+{
+    TA_FREEP(&mpctx->script_executor);
+}
+
+static void add_task(struct mp_script_args *arg)
+{
+    struct mp_script_executor *ex = arg->mpctx->script_executor;
+
+    struct script_task *task = talloc_ptrtype(NULL, task);
+    *task = (struct script_task){
+        .ex = ex,
+        .arg = arg,
+        .deadline = INT64_MAX,
+        .wakeup = true,
+    };
+
+    // Set this first: once the task is added, it can finish at any time.
+    mpv_set_wakeup_callback(arg->client, wakeup_task, task);
+
+    pthread_mutex_lock(&ex->lock);
+    MP_TARRAY_APPEND(ex, ex->tasks, ex->num_tasks, task);
+    pthread_cond_signal(&ex->wakeup);
+    pthread_mutex_unlock(&ex->lock);
+}
+
 static void run_script(struct mp_script_args *arg)
 {
     char name[90];
@@ -88,11 +268,15 @@ static void run_script(struct mp_script_args *arg)
              mpv_client_name(arg->client));
     mpthread_set_name(name);
 
-    if (arg->backend->load(arg) < 0)
+    if (arg->backend->load(arg) < 0) {
         MP_ERR(arg, "Could not load %s %s\n", arg->backend->name, arg->filename);
+    } else if (arg->task_run) {
+        // The script continues on the shared executor; this thread is done.
+        add_task(arg);
+        return;
+    }
 
-    mpv_destroy(arg->client);
-    talloc_free(arg);
+    destroy_script(arg);
 }
 
 static void *script_thread(void *p)
@@ -167,6 +351,7 @@ static int64_t mp_load_script(struct MPContext *mpctx, const char *fname)
         .filename = talloc_strdup(arg, fname),
         .path = talloc_strdup(arg, path),
         .backend = backend,
+        .use_executor = backend->tasks && get_executor(mpctx),
         // Create the client before creating the thread; otherwise a race
         // condition could happen, where MPContext is destroyed while the
         // thread tries to create the client.
@@ -65,7 +65,41 @@ union aligned_header {
 #define PTR_TO_HEADER(ptr) (&((union aligned_header *)(ptr) - 1)->ta)
 #define PTR_FROM_HEADER(h) ((void *)((union aligned_header *)(h) + 1))
 
-#define MAX_ALLOC (((size_t)-1) - sizeof(union aligned_header))
+// Flags stored in the upper bits of ta_header.size. Allocations with either
+// flag set are preceded by a union arena_prefix.
+#define ARENA_ROOT      (((size_t)-1 >> 1) + 1) // malloc'ed, owns the arena
+#define ARENA_MEMBER    (ARENA_ROOT >> 1)       // carved from arena chunks
+#define SIZE_FLAGS      (ARENA_ROOT | ARENA_MEMBER)
+
+#define MAX_ALLOC ((((size_t)-1) & ~SIZE_FLAGS) - sizeof(union aligned_header) \
+                   - sizeof(union arena_prefix))
+
+#define ALIGN_UP(x) (((x) + MIN_ALIGN - 1) & ~(size_t)(MIN_ALIGN - 1))
+
+// Arena chunks start at this size, and double up to the maximum.
+#define ARENA_CHUNK_MIN (4 * 1024)
+#define ARENA_CHUNK_MAX (64 * 1024)
+
+struct ta_arena_chunk {
+    struct ta_arena_chunk *next;
+};
+
+#define CHUNK_HEADER ALIGN_UP(sizeof(struct ta_arena_chunk))
+
+// Lives in the first chunk, so it has a stable address even if the arena
+// root is reallocated.
+struct ta_arena {
+    struct ta_arena_chunk *chunks;  // all chunks, newest first
+    char *pos, *end;                // free space in the current chunk
+    size_t chunk_size;              // size of the next chunk
+};
+
+union arena_prefix {
+    struct ta_arena *arena;         // NULL for roots without members yet
+    char align_min[ALIGN_UP(sizeof(struct ta_arena *))];
+};
+
+#define PREFIX_FROM_HEADER(h) ((union arena_prefix *)(h) - 1)
 
 static void ta_dbg_add(struct ta_header *h);
 static void ta_dbg_check_header(struct ta_header *h);
@@ -78,20 +112,134 @@ static struct ta_header *get_header(void *ptr)
     return h;
 }
 
-/* Set the parent allocation of ptr. If parent==NULL, remove the parent.
- * Setting parent==NULL (with ptr!=NULL) unsets the parent of ptr.
- * With ptr==NULL, the function does nothing.
- *
- * Warning: if ta_parent is a direct or indirect child of ptr, things will go
- *          wrong. The function will apparently succeed, but creates circular
- *          parent links, which are not allowed.
- */
-void ta_set_parent(void *ptr, void *ta_parent)
+static size_t get_size(struct ta_header *h)
 {
-    struct ta_header *ch = get_header(ptr);
-    if (!ch)
+    return h->size & ~SIZE_FLAGS;
+}
+
+// Return the arena h belongs to or owns, or NULL.
+static struct ta_arena *get_arena(struct ta_header *h)
+{
+    return h && (h->size & SIZE_FLAGS) ? PREFIX_FROM_HEADER(h)->arena : NULL;
+}
+
+// Total size of an arena member, including prefix and header.
+static size_t arena_block_size(size_t size)
+{
+    return sizeof(union arena_prefix) + sizeof(union aligned_header) +
+           ALIGN_UP(size);
+}
+
+static struct ta_arena *arena_create(void)
+{
+    size_t offset = CHUNK_HEADER + ALIGN_UP(sizeof(struct ta_arena));
+    struct ta_arena_chunk *c = malloc(offset + ARENA_CHUNK_MIN);
+    if (!c)
+        return NULL;
+    c->next = NULL;
+    struct ta_arena *a = (struct ta_arena *)((char *)c + CHUNK_HEADER);
+    *a = (struct ta_arena) {
+        .chunks = c,
+        .pos = (char *)c + offset,
+        .end = (char *)c + offset + ARENA_CHUNK_MIN,
+        .chunk_size = ARENA_CHUNK_MIN * 2,
+    };
+    return a;
+}
+
+static void arena_destroy(struct ta_arena *a)
+{
+    if (!a)
         return;
-    struct ta_header *new_parent = get_header(ta_parent);
+    // a itself lives in one of the chunks.
+    struct ta_arena_chunk *c = a->chunks;
+    while (c) {
+        struct ta_arena_chunk *next = c->next;
+        free(c);
+        c = next;
+    }
+}
+
+// Bump-allocate size bytes (must be a multiple of MIN_ALIGN).
+static void *arena_alloc(struct ta_arena *a, size_t size)
+{
+    if ((size_t)(a->end - a->pos) < size) {
+        size_t chunk_size = a->chunk_size;
+        // Large blocks get a chunk of their own, so that the rest of the
+        // current chunk is not wasted.
+        bool dedicated = size > chunk_size / 4;
+        if (dedicated)
+            chunk_size = size;
+        struct ta_arena_chunk *c = malloc(CHUNK_HEADER + chunk_size);
+        if (!c)
+            return NULL;
+        c->next = a->chunks;
+        a->chunks = c;
+        char *mem = (char *)c + CHUNK_HEADER;
+        if (dedicated)
+            return mem;
+        a->pos = mem;
+        a->end = mem + chunk_size;
+        if (a->chunk_size < ARENA_CHUNK_MAX)
+            a->chunk_size *= 2;
+    }
+    void *ptr = a->pos;
+    a->pos += size;
+    return ptr;
+}
+
+// Allocate an uninitialized arena member with parent as arena root or member.
+static struct ta_header *arena_alloc_header(struct ta_header *parent,
+                                            size_t size)
+{
+    union arena_prefix *parent_prefix = PREFIX_FROM_HEADER(parent);
+    if (!parent_prefix->arena) {
+        assert(parent->size & ARENA_ROOT);
+        parent_prefix->arena = arena_create();
+        if (!parent_prefix->arena)
+            return NULL;
+    }
+    struct ta_arena *a = parent_prefix->arena;
+    union arena_prefix *prefix = arena_alloc(a, arena_block_size(size));
+    if (!prefix)
+        return NULL;
+    prefix->arena = a;
+    return (struct ta_header *)(prefix + 1);
+}
+
+// Resize an arena member. Returns the new header (possibly h itself), or NULL.
+static struct ta_header *arena_realloc(struct ta_header *h, size_t size)
+{
+    struct ta_arena *a = get_arena(h);
+    char *block = (char *)PREFIX_FROM_HEADER(h);
+    size_t old_size = arena_block_size(get_size(h));
+    size_t new_size = arena_block_size(size);
+    bool is_last = block + old_size == a->pos;
+    // Shrinking, or growing the most recent allocation, works in place.
+    if (new_size <= old_size || (is_last && (size_t)(a->end - block) >= new_size)) {
+        if (is_last)
+            a->pos = block + new_size;
+        return h;
+    }
+    union arena_prefix *prefix = arena_alloc(a, new_size);
+    if (!prefix)
+        return NULL;
+    memcpy(prefix, block, old_size);
+    return (struct ta_header *)(prefix + 1);
+}
+
+// Give the memory of a freed arena member back if it was the most recent
+// allocation. Otherwise it's reclaimed only when the arena root is freed.
+static void arena_release(struct ta_header *h)
+{
+    struct ta_arena *a = get_arena(h);
+    char *block = (char *)PREFIX_FROM_HEADER(h);
+    if (block + arena_block_size(get_size(h)) == a->pos)
+        a->pos = block;
+}
+
+static void set_parent(struct ta_header *ch, struct ta_header *new_parent)
+{
     // Unlink from previous parent
     if (ch->prev)
         ch->prev->next = ch->next;
@@ -119,6 +267,28 @@ void ta_set_parent(void *ptr, void *ta_parent)
     }
 }
 
+/* Set the parent allocation of ptr. If parent==NULL, remove the parent.
+ * Setting parent==NULL (with ptr!=NULL) unsets the parent of ptr.
+ * With ptr==NULL, the function does nothing.
+ *
+ * Allocations made from an arena (see ta_zalloc_arena_size()) can be moved
+ * only to another parent within the same arena, since their memory is owned
+ * by the arena root.
+ *
+ * Warning: if ta_parent is a direct or indirect child of ptr, things will go
+ *          wrong. The function will apparently succeed, but creates circular
+ *          parent links, which are not allowed.
+ */
+void ta_set_parent(void *ptr, void *ta_parent)
+{
+    struct ta_header *ch = get_header(ptr);
+    if (!ch)
+        return;
+    struct ta_header *new_parent = get_header(ta_parent);
+    assert(!(ch->size & ARENA_MEMBER) || get_arena(ch) == get_arena(new_parent));
+    set_parent(ch, new_parent);
+}
+
 /* Return the parent allocation, or NULL if none or if ptr==NULL.
  *
  * Warning: do not use this for program logic, or I'll be sad.
@@ -129,40 +299,78 @@ void *ta_get_parent(void *ptr)
     return ch ? ch->parent : NULL;
 }
 
+static void *alloc_size(void *ta_parent, size_t size, bool zero)
+{
+    if (size >= MAX_ALLOC)
+        return NULL;
+    struct ta_header *parent = get_header(ta_parent);
+    struct ta_header *h;
+    size_t flags = 0;
+    if (parent && (parent->size & SIZE_FLAGS)) {
+        h = arena_alloc_header(parent, size);
+        if (h && zero)
+            memset(PTR_FROM_HEADER(h), 0, size);
+        flags = ARENA_MEMBER;
+    } else if (zero) {
+        h = calloc(1, sizeof(union aligned_header) + size);
+    } else {
+        h = malloc(sizeof(union aligned_header) + size);
+    }
+    if (!h)
+        return NULL;
+    *h = (struct ta_header) {.size = size | flags};
+    ta_dbg_add(h);
+    set_parent(h, parent);
+    return PTR_FROM_HEADER(h);
+}
+
 /* Allocate size bytes of memory. If ta_parent is not NULL, this is used as
  * parent allocation (if ta_parent is freed, this allocation is automatically
  * freed as well). size==0 allocates a block of size 0 (i.e. returns non-NULL).
+ * If ta_parent belongs to an arena, the memory is taken from the arena.
  * Returns NULL on OOM.
  */
 void *ta_alloc_size(void *ta_parent, size_t size)
 {
-    if (size >= MAX_ALLOC)
-        return NULL;
-    struct ta_header *h = malloc(sizeof(union aligned_header) + size);
-    if (!h)
-        return NULL;
-    *h = (struct ta_header) {.size = size};
-    ta_dbg_add(h);
-    void *ptr = PTR_FROM_HEADER(h);
-    ta_set_parent(ptr, ta_parent);
-    return ptr;
+    return alloc_size(ta_parent, size, false);
 }
 
 /* Exactly the same as ta_alloc_size(), but the returned memory block is
  * initialized to 0.
  */
 void *ta_zalloc_size(void *ta_parent, size_t size)
+{
+    return alloc_size(ta_parent, size, true);
+}
+
+/* Like ta_zalloc_size(), but the new allocation becomes the root of an arena.
+ * Allocations with the root or with another allocation of the same arena as
+ * parent are bump-allocated from larger chunks of memory owned by the root,
+ * instead of going through malloc() each.
+ *
+ * All TA functions keep working on arena allocations. But freeing or shrinking
+ * them generally does not make memory available again, until the arena root
+ * is freed. An arena allocation must not be moved outside of its arena with
+ * ta_set_parent(). The arena root itself is a normal allocation, and can be
+ * moved freely. Allocations not made from the arena (e.g. those moved into it
+ * with ta_set_parent()) are freed with free() as usual.
+ *
+ * This is intended for short-lived trees of many small allocations that are
+ * freed all at once.
+ */
+void *ta_zalloc_arena_size(void *ta_parent, size_t size)
 {
     if (size >= MAX_ALLOC)
         return NULL;
-    struct ta_header *h = calloc(1, sizeof(union aligned_header) + size);
-    if (!h)
+    union arena_prefix *prefix =
+        calloc(1, sizeof(union arena_prefix) + sizeof(union aligned_header) + size);
+    if (!prefix)
         return NULL;
-    *h = (struct ta_header) {.size = size};
+    struct ta_header *h = (struct ta_header *)(prefix + 1);
+    *h = (struct ta_header) {.size = size | ARENA_ROOT};
     ta_dbg_add(h);
-    void *ptr = PTR_FROM_HEADER(h);
-    ta_set_parent(ptr, ta_parent);
-    return ptr;
+    set_parent(h, get_header(ta_parent));
+    return PTR_FROM_HEADER(h);
 }
 
 /* Reallocate the allocation given by ptr and return a new pointer. Much like
@@ -189,14 +397,23 @@ void *ta_realloc_size(void *ta_parent, void *ptr, size_t size)
         return ta_alloc_size(ta_parent, size);
     struct ta_header *h = get_header(ptr);
     struct ta_header *old_h = h;
-    if (h->size == size)
+    size_t flags = h->size & SIZE_FLAGS;
+    if (get_size(h) == size)
         return ptr;
     ta_dbg_remove(h);
-    h = realloc(h, sizeof(union aligned_header) + size);
+    if (flags & ARENA_MEMBER) {
+        h = arena_realloc(h, size);
+    } else if (flags & ARENA_ROOT) {
+        union arena_prefix *prefix = realloc(PREFIX_FROM_HEADER(h),
+            sizeof(union arena_prefix) + sizeof(union aligned_header) + size);
+        h = prefix ? (struct ta_header *)(prefix + 1) : NULL;
+    } else {
+        h = realloc(h, sizeof(union aligned_header) + size);
+    }
     ta_dbg_add(h ? h : old_h);
     if (!h)
         return NULL;
-    h->size = size;
+    h->size = size | flags;
     if (h != old_h) {
         // Relink parent
         if (h->parent)
@@ -220,7 +437,7 @@ void *ta_realloc_size(void *ta_parent, void *ptr, size_t size)
 size_t ta_get_size(void *ptr)
 {
     struct ta_header *h = get_header(ptr);
-    return h ? h->size : 0;
+    return h ? get_size(h) : 0;
 }
 
 /* Free all allocations that (recursively) have ptr as parent allocation, but
@@ -243,9 +460,16 @@ void ta_free(void *ptr)
     if (h->destructor)
         h->destructor(ptr);
     ta_free_children(ptr);
-    ta_set_parent(ptr, NULL);
+    set_parent(h, NULL);
     ta_dbg_remove(h);
-    free(h);
+    if (h->size & ARENA_MEMBER) {
+        arena_release(h);
+    } else if (h->size & ARENA_ROOT) {
+        arena_destroy(PREFIX_FROM_HEADER(h)->arena);
+        free(PREFIX_FROM_HEADER(h));
+    } else {
+        free(h);
+    }
 }
 
 /* Set a destructor that is to be called when the given allocation is freed.
@@ -315,7 +539,7 @@ static size_t get_children_size(struct ta_header *h)
 {
     size_t size = 0;
     for (struct ta_header *s = h->child; s; s = s->next)
-        size += s->size + get_children_size(s);
+        size += get_size(s) + get_children_size(s);
     return size;
 }
 
@@ -338,16 +562,16 @@ static void print_leak_report(void)
                     snprintf(name, sizeof(name), "%s", cur->name);
                 if (cur->name == &allocation_is_string) {
                     snprintf(name, sizeof(name), "'%.*s'",
-                             (int)cur->size, (char *)PTR_FROM_HEADER(cur));
+                             (int)get_size(cur), (char *)PTR_FROM_HEADER(cur));
                 }
                 for (int n = 0; n < sizeof(name); n++) {
                     if (name[n] && name[n] < 0x20)
                         name[n] = '.';
                 }
                 fprintf(stderr, "  %-20p %10zu %10zu  %s\n",
-                        cur, cur->size, c_size, name);
+                        cur, get_size(cur), c_size, name);
             }
-            size += cur->size;
+            size += get_size(cur);
             num_blocks += 1;
             // Unlink, and don't confuse valgrind by leaving live pointers.
             cur->leak_next->leak_prev = cur->leak_prev;
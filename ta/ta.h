@@ -46,6 +46,7 @@
 // Core functions
 void *ta_alloc_size(void *ta_parent, size_t size);
 void *ta_zalloc_size(void *ta_parent, size_t size);
+void *ta_zalloc_arena_size(void *ta_parent, size_t size);
 void *ta_realloc_size(void *ta_parent, void *ptr, size_t size);
 size_t ta_get_size(void *ptr);
 void ta_free(void *ptr);
@@ -58,6 +59,7 @@ void *ta_get_parent(void *ptr);
 size_t ta_calc_array_size(size_t element_size, size_t count);
 size_t ta_calc_prealloc_elems(size_t nextidx);
 void *ta_new_context(void *ta_parent);
+void *ta_new_arena(void *ta_parent);
 void *ta_steal_(void *ta_parent, void *ptr);
 void *ta_memdup(void *ta_parent, void *ptr, size_t size);
 char *ta_strdup(void *ta_parent, const char *str);
@@ -107,6 +109,8 @@ bool ta_vasprintf_append_buffer(char **str, const char *fmt, va_list ap) TA_PRF(
 #define ta_xalloc_size(...)             ta_oom_p(ta_alloc_size(__VA_ARGS__))
 #define ta_xzalloc_size(...)            ta_oom_p(ta_zalloc_size(__VA_ARGS__))
 #define ta_xnew_context(...)            ta_oom_p(ta_new_context(__VA_ARGS__))
+#define ta_xnew_arena(...)              ta_oom_p(ta_new_arena(__VA_ARGS__))
+#define ta_xzalloc_arena_size(...)      ta_oom_p(ta_zalloc_arena_size(__VA_ARGS__))
 #define ta_xstrdup_append(...)          ta_oom_b(ta_strdup_append(__VA_ARGS__))
 #define ta_xstrdup_append_buffer(...)   ta_oom_b(ta_strdup_append_buffer(__VA_ARGS__))
 #define ta_xstrndup_append(...)         ta_oom_b(ta_strndup_append(__VA_ARGS__))
@@ -138,6 +142,7 @@ void *ta_xrealloc_size(void *ta_parent, void *ptr, size_t size);
 #ifndef TA_NO_WRAPPERS
 #define ta_alloc_size(...)      ta_dbg_set_loc(ta_alloc_size(__VA_ARGS__), TA_LOC)
 #define ta_zalloc_size(...)     ta_dbg_set_loc(ta_zalloc_size(__VA_ARGS__), TA_LOC)
+#define ta_zalloc_arena_size(...) ta_dbg_set_loc(ta_zalloc_arena_size(__VA_ARGS__), TA_LOC)
 #define ta_realloc_size(...)    ta_dbg_set_loc(ta_realloc_size(__VA_ARGS__), TA_LOC)
 #define ta_memdup(...)          ta_dbg_set_loc(ta_memdup(__VA_ARGS__), TA_LOC)
 #define ta_xmemdup(...)         ta_dbg_set_loc(ta_xmemdup(__VA_ARGS__), TA_LOC)
@@ -37,10 +37,12 @@
 #define talloc_steal                    ta_steal
 #define talloc_realloc_size             ta_xrealloc_size
 #define talloc_new                      ta_xnew_context
+#define talloc_new_arena                ta_xnew_arena
 #define talloc_set_destructor           ta_set_destructor
 #define talloc_enable_leak_report       ta_enable_leak_report
 #define talloc_size                     ta_xalloc_size
 #define talloc_zero_size                ta_xzalloc_size
+#define talloc_zero_arena_size          ta_xzalloc_arena_size
 #define talloc_get_size                 ta_get_size
 #define talloc_free_children            ta_free_children
 #define talloc_free                     ta_free
@@ -51,6 +51,14 @@ void *ta_new_context(void *ta_parent)
     return ta_alloc_size(ta_parent, 0);
 }
 
+/* Create an empty (size 0) TA allocation, which is the root of an arena. See
+ * ta_zalloc_arena_size().
+ */
+void *ta_new_arena(void *ta_parent)
+{
+    return ta_zalloc_arena_size(ta_parent, 0);
+}
+
 /* Set parent of ptr to ta_parent, return the ptr.
  * Note that ta_parent==NULL will simply unset the current parent of ptr.
  */
@@ -77,8 +85,9 @@ void *ta_memdup(void *ta_parent, void *ptr, size_t size)
 
 // *str = *str[0..at] + append[0..append_len]
 // (append_len being a maximum length; shorter if embedded \0s are encountered)
-static bool strndup_append_at(char **str, size_t at, const char *append,
-                              size_t append_len)
+// ta_parent is used only if *str==NULL.
+static bool strndup_append_at(void *ta_parent, char **str, size_t at,
+                              const char *append, size_t append_len)
 {
     assert(ta_get_size(*str) >= at);
 
@@ -90,7 +99,7 @@ static bool strndup_append_at(char **str, size_t at, const char *append,
         append_len = real_len;
 
     if (ta_get_size(*str) < at + append_len + 1) {
-        char *t = ta_realloc_size(NULL, *str, at + append_len + 1);
+        char *t = ta_realloc_size(ta_parent, *str, at + append_len + 1);
         if (!t)
             return false;
         *str = t;
@@ -124,8 +133,7 @@ char *ta_strndup(void *ta_parent, const char *str, size_t n)
     if (!str)
         return NULL;
     char *new = NULL;
-    strndup_append_at(&new, 0, str, n);
-    ta_set_parent(new, ta_parent);
+    strndup_append_at(ta_parent, &new, 0, str, n);
     return new;
 }
 
@@ -135,7 +143,7 @@ char *ta_strndup(void *ta_parent, const char *str, size_t n)
  */
 bool ta_strdup_append(char **str, const char *a)
 {
-    return strndup_append_at(str, *str ? strlen(*str) : 0, a, (size_t)-1);
+    return strndup_append_at(NULL, str, *str ? strlen(*str) : 0, a, (size_t)-1);
 }
 
 /* Like ta_strdup_append(), but use ta_get_size(*str)-1 instead of strlen(*str).
@@ -146,7 +154,7 @@ bool ta_strdup_append_buffer(char **str, const char *a)
     size_t size = ta_get_size(*str);
     if (size > 0)
         size -= 1;
-    return strndup_append_at(str, size, a, (size_t)-1);
+    return strndup_append_at(NULL, str, size, a, (size_t)-1);
 }
 
 /* Like ta_strdup_append(), but limit the length of a with n.
@@ -154,7 +162,7 @@ bool ta_strdup_append_buffer(char **str, const char *a)
  */
 bool ta_strndup_append(char **str, const char *a, size_t n)
 {
-    return strndup_append_at(str, *str ? strlen(*str) : 0, a, n);
+    return strndup_append_at(NULL, str, *str ? strlen(*str) : 0, a, n);
 }
 
 /* Like ta_strdup_append_buffer(), but limit the length of a with n.
@@ -165,11 +173,11 @@ bool ta_strndup_append_buffer(char **str, const char *a, size_t n)
     size_t size = ta_get_size(*str);
     if (size > 0)
         size -= 1;
-    return strndup_append_at(str, size, a, n);
+    return strndup_append_at(NULL, str, size, a, n);
 }
 
-static bool ta_vasprintf_append_at(char **str, size_t at, const char *fmt,
-                                   va_list ap)
+static bool ta_vasprintf_append_at(void *ta_parent, char **str, size_t at,
+                                   const char *fmt, va_list ap)
 {
     assert(ta_get_size(*str) >= at);
 
@@ -184,7 +192,7 @@ static bool ta_vasprintf_append_at(char **str, size_t at, const char *fmt,
         return false;
 
     if (ta_get_size(*str) < at + size + 1) {
-        char *t = ta_realloc_size(NULL, *str, at + size + 1);
+        char *t = ta_realloc_size(ta_parent, *str, at + size + 1);
         if (!t)
             return false;
         *str = t;
@@ -212,8 +220,7 @@ char *ta_asprintf(void *ta_parent, const char *fmt, ...)
 char *ta_vasprintf(void *ta_parent, const char *fmt, va_list ap)
 {
     char *res = NULL;
-    ta_vasprintf_append_at(&res, 0, fmt, ap);
-    ta_set_parent(res, ta_parent);
+    ta_vasprintf_append_at(ta_parent, &res, 0, fmt, ap);
     if (!res) {
         ta_free(res);
         return NULL;
@@ -237,7 +244,7 @@ bool ta_asprintf_append(char **str, const char *fmt, ...)
 
 bool ta_vasprintf_append(char **str, const char *fmt, va_list ap)
 {
-    return ta_vasprintf_append_at(str, *str ? strlen(*str) : 0, fmt, ap);
+    return ta_vasprintf_append_at(NULL, str, *str ? strlen(*str) : 0, fmt, ap);
 }
 
 /* Append the formatted string at the end of the allocation of *str. It
@@ -262,7 +269,7 @@ bool ta_vasprintf_append_buffer(char **str, const char *fmt, va_list ap)
     size_t size = ta_get_size(*str);
     if (size > 0)
         size -= 1;
-    return ta_vasprintf_append_at(str, size, fmt, ap);
+    return ta_vasprintf_append_at(NULL, str, size, fmt, ap);
 }
 
 
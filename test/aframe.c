@@ -0,0 +1,97 @@
+#include "audio/aframe.h"
+#include "audio/chmap.h"
+#include "audio/format.h"
+#include "tests.h"
+
+static void reverse_ref(uint8_t *dst, const uint8_t *src, int samples,
+                        size_t sstride)
+{
+    for (int n = 0; n < samples; n++)
+        memcpy(dst + n * sstride, src + (samples - 1 - n) * sstride, sstride);
+}
+
+static void test_reverse_samples(size_t sstride, int samples)
+{
+    size_t size = sstride * samples;
+    uint8_t *data = talloc_size(NULL, size + 1);
+    uint8_t *orig = talloc_size(NULL, size + 1);
+    uint8_t *ref = talloc_size(NULL, size + 1);
+
+    for (size_t n = 0; n < size + 1; n++)
+        data[n] = n * 7 + 3;
+    data[size] = 0xAB; // guard byte
+    memcpy(orig, data, size + 1);
+
+    reverse_ref(ref, orig, samples, sstride);
+    af_reverse_samples(data, samples, sstride);
+    assert_memcmp(data, ref, size);
+    assert_int_equal(data[size], 0xAB);
+
+    // Reversing twice must give the original data.
+    af_reverse_samples(data, samples, sstride);
+    assert_memcmp(data, orig, size);
+
+    talloc_free(data);
+    talloc_free(orig);
+    talloc_free(ref);
+}
+
+static void test_reverse_frame(int format, int channels, int samples)
+{
+    struct mp_chmap chmap;
+    mp_chmap_set_unknown(&chmap, channels);
+
+    struct mp_aframe *f = mp_aframe_create();
+    assert_true(mp_aframe_set_format(f, format));
+    assert_true(mp_aframe_set_chmap(f, &chmap));
+    assert_true(mp_aframe_set_rate(f, 48000));
+    assert_true(mp_aframe_alloc_data(f, samples));
+
+    int planes = mp_aframe_get_planes(f);
+    size_t sstride = mp_aframe_get_sstride(f);
+    size_t plane_size = sstride * samples;
+    uint8_t **d = mp_aframe_get_data_rw(f);
+    assert_true(d);
+
+    uint8_t *orig = talloc_size(NULL, plane_size * planes);
+    for (int p = 0; p < planes; p++) {
+        for (size_t n = 0; n < plane_size; n++)
+            d[p][n] = n * 13 + p;
+        memcpy(orig + p * plane_size, d[p], plane_size);
+    }
+
+    assert_true(mp_aframe_reverse(f));
+
+    uint8_t *ref = talloc_size(NULL, plane_size);
+    for (int p = 0; p < planes; p++) {
+        reverse_ref(ref, orig + p * plane_size, samples, sstride);
+        assert_memcmp(d[p], ref, plane_size);
+    }
+
+    talloc_free(ref);
+    talloc_free(orig);
+    talloc_free(f);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    static const size_t strides[] = {1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48};
+    static const int sizes[] = {0, 1, 2, 3, 7, 64, 1001};
+
+    for (int s = 0; s < MP_ARRAY_SIZE(strides); s++) {
+        for (int n = 0; n < MP_ARRAY_SIZE(sizes); n++)
+            test_reverse_samples(strides[s], sizes[n]);
+    }
+
+    test_reverse_frame(AF_FORMAT_S16, 2, 1024);
+    test_reverse_frame(AF_FORMAT_S16P, 2, 1023);
+    test_reverse_frame(AF_FORMAT_FLOAT, 6, 999);
+    test_reverse_frame(AF_FORMAT_FLOATP, 6, 1);
+    test_reverse_frame(AF_FORMAT_DOUBLE, 3, 17);
+    test_reverse_frame(AF_FORMAT_U8, 1, 5);
+}
+
+const struct unittest test_aframe = {
+    .name = "aframe",
+    .run = run,
+};
@@ -0,0 +1,139 @@
+#include <stddef.h>
+
+#include "common/common.h"
+#include "options/m_config_core.h"
+#include "options/m_option.h"
+#include "tests.h"
+
+#define NUM_STRINGS 200
+
+struct sub_opts {
+    int value;
+    char *text;
+};
+
+struct root_opts {
+    int volume;
+    char *strings[NUM_STRINGS];
+    struct sub_opts *sub;
+};
+
+#define OPT_BASE_STRUCT struct sub_opts
+static const struct m_sub_options sub_conf = {
+    .opts = (const struct m_option[]){
+        {"value", OPT_INT(value), .flags = UPDATE_OSD},
+        {"text", OPT_STRING(text)},
+        {0}
+    },
+    .size = sizeof(struct sub_opts),
+    .defaults = &(const struct sub_opts){
+        .value = 1,
+    },
+};
+
+#undef OPT_BASE_STRUCT
+#define OPT_BASE_STRUCT struct root_opts
+
+// Many options with dynamic allocation, so that comparing all of them on
+// each update would be expensive.
+static struct m_sub_options *create_root_conf(void *ta_parent)
+{
+    struct m_option *opts = talloc_zero_array(ta_parent, struct m_option,
+                                              NUM_STRINGS + 3);
+    opts[0] = (struct m_option){"volume", OPT_INT(volume)};
+    for (int n = 0; n < NUM_STRINGS; n++) {
+        opts[n + 1] = (struct m_option){
+            .name = talloc_asprintf(ta_parent, "string%d", n),
+            .type = &m_option_type_string,
+            .offset = offsetof(struct root_opts, strings) + n * sizeof(char *),
+        };
+    }
+    opts[NUM_STRINGS + 1] = (struct m_option){"sub", OPT_SUBSTRUCT(sub, sub_conf)};
+
+    struct m_sub_options *conf = talloc_ptrtype(ta_parent, conf);
+    *conf = (struct m_sub_options){
+        .opts = opts,
+        .size = sizeof(struct root_opts),
+    };
+    return conf;
+}
+
+static void test_updates(struct m_sub_options *root_conf)
+{
+    struct m_config_shadow *shadow = m_config_shadow_new(root_conf);
+    struct m_config_cache *writer =
+        m_config_cache_from_shadow(NULL, shadow, root_conf);
+    struct m_config_cache *reader =
+        m_config_cache_from_shadow(NULL, shadow, root_conf);
+    struct m_config_cache *sub_reader =
+        m_config_cache_from_shadow(NULL, shadow, &sub_conf);
+    struct root_opts *wopts = writer->opts;
+    struct root_opts *ropts = reader->opts;
+    struct sub_opts *sopts = sub_reader->opts;
+
+    assert_false(m_config_cache_update(reader));
+
+    // Writing an unchanged value is not a change.
+    assert_false(m_config_cache_write_opt(writer, &wopts->volume));
+
+    wopts->volume = 50;
+    assert_true(m_config_cache_write_opt(writer, &wopts->volume));
+    assert_true(m_config_cache_update(reader));
+    assert_int_equal(ropts->volume, 50);
+    assert_false(m_config_cache_update(sub_reader));
+    assert_false(m_config_cache_update(reader));
+
+    wopts->sub->value = 2;
+    assert_true(m_config_cache_write_opt(writer, &wopts->sub->value));
+    talloc_free(wopts->strings[7]);
+    wopts->strings[7] = talloc_strdup(NULL, "seven");
+    assert_true(m_config_cache_write_opt(writer, &wopts->strings[7]));
+
+    void *p;
+    assert_true(m_config_cache_get_next_changed(reader, &p));
+    assert_true(p == &ropts->strings[7]);
+    assert_string_equal(ropts->strings[7], "seven");
+    assert_true(m_config_cache_get_next_changed(reader, &p));
+    assert_true(p == &ropts->sub->value);
+    assert_int_equal(ropts->sub->value, 2);
+    assert_true(reader->change_flags & UPDATE_OSD);
+    assert_false(m_config_cache_get_next_changed(reader, &p));
+
+    assert_true(m_config_cache_update(sub_reader));
+    assert_int_equal(sopts->value, 2);
+
+    // Option written while the reader is in the middle of an incremental
+    // update, before the reader's current position. (This restarts it.)
+    wopts->strings[1] = talloc_strdup(NULL, "one");
+    assert_true(m_config_cache_write_opt(writer, &wopts->strings[1]));
+    wopts->strings[3] = talloc_strdup(NULL, "three");
+    assert_true(m_config_cache_write_opt(writer, &wopts->strings[3]));
+    assert_true(m_config_cache_get_next_changed(reader, &p));
+    assert_true(p == &ropts->strings[1]);
+    wopts->volume = 60;
+    assert_true(m_config_cache_write_opt(writer, &wopts->volume));
+    assert_true(m_config_cache_get_next_changed(reader, &p));
+    assert_true(p == &ropts->volume);
+    assert_int_equal(ropts->volume, 60);
+    assert_true(m_config_cache_get_next_changed(reader, &p));
+    assert_true(p == &ropts->strings[3]);
+    assert_false(m_config_cache_get_next_changed(reader, &p));
+
+    talloc_free(sub_reader);
+    talloc_free(reader);
+    talloc_free(writer);
+    talloc_free(shadow);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    void *ta_ctx = talloc_new(NULL);
+    struct m_sub_options *root_conf = create_root_conf(ta_ctx);
+    test_updates(root_conf);
+    talloc_free(ta_ctx);
+}
+
+const struct unittest test_config_cache = {
+    .name = "config_cache",
+    .run = run,
+};
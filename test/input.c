@@ -0,0 +1,138 @@
+#include "common/common.h"
+#include "input/cmd.h"
+#include "input/input.h"
+#include "input/keycodes.h"
+#include "tests.h"
+
+static void wakeup(void *p)
+{
+    if (p)
+        (*(int *)p)++;
+}
+
+// Press and release the key, and return the command it was mapped to.
+static char *press_key(void *ta_parent, struct input_ctx *ictx, int code)
+{
+    mp_input_put_key(ictx, code);
+    struct mp_cmd *cmd = mp_input_read_cmd(ictx);
+    char *res = cmd ? talloc_strdup(ta_parent, cmd->original) : NULL;
+    talloc_free(cmd);
+    while ((cmd = mp_input_read_cmd(ictx)))
+        talloc_free(cmd);
+    return res;
+}
+
+static void test_lookup(struct test_ctx *ctx)
+{
+    void *tmp = talloc_new(NULL);
+    struct input_ctx *ictx = mp_input_init(ctx->global, wakeup, NULL);
+
+    mp_input_define_section(ictx, "test", "<test>",
+                            "a show-text builtin-a\n"
+                            "b show-text builtin-b\n"
+                            "x-y show-text builtin-x-y\n",
+                            true, "test");
+    mp_input_define_section(ictx, "test", "<test>",
+                            "a show-text user-a\n"
+                            "z show-text user-z\n"
+                            "w-z show-text user-w-z\n",
+                            false, "test");
+    mp_input_enable_section(ictx, "test", 0);
+
+    // User bindings take priority over builtin ones.
+    assert_string_equal(press_key(tmp, ictx, 'a'), "show-text user-a");
+    assert_string_equal(press_key(tmp, ictx, 'b'), "show-text builtin-b");
+
+    // Key sequences, where the longest matching sequence wins.
+    assert_true(!press_key(tmp, ictx, 'x'));
+    assert_string_equal(press_key(tmp, ictx, 'y'), "show-text builtin-x-y");
+    assert_true(!press_key(tmp, ictx, 'y'));
+    assert_string_equal(press_key(tmp, ictx, 'z'), "show-text user-z");
+    assert_true(!press_key(tmp, ictx, 'w'));
+    assert_string_equal(press_key(tmp, ictx, 'z'), "show-text user-w-z");
+
+    // Redefining the section replaces and removes bindings.
+    mp_input_define_section(ictx, "test", "<test>", "c show-text user-c\n",
+                            false, "test");
+    mp_input_enable_section(ictx, "test", 0);
+    assert_string_equal(press_key(tmp, ictx, 'a'), "show-text builtin-a");
+    assert_string_equal(press_key(tmp, ictx, 'c'), "show-text user-c");
+    assert_true(!press_key(tmp, ictx, 'z'));
+
+    // Sections on top of the stack take priority.
+    mp_input_define_section(ictx, "top", "<test>", "c show-text top-c\n",
+                            false, "test");
+    mp_input_enable_section(ictx, "top", 0);
+    assert_string_equal(press_key(tmp, ictx, 'c'), "show-text top-c");
+    mp_input_disable_section(ictx, "top");
+    assert_string_equal(press_key(tmp, ictx, 'c'), "show-text user-c");
+
+    mp_input_uninit(ictx);
+    talloc_free(tmp);
+}
+
+static void test_coalesce(struct test_ctx *ctx)
+{
+    int wakeups = 0;
+    struct input_ctx *ictx = mp_input_init(ctx->global, wakeup, &wakeups);
+
+    mp_input_define_section(ictx, "test", "<test>",
+                            "MOUSE_MOVE show-text move\n"
+                            "WHEEL_UP add volume 2\n"
+                            "WHEEL_DOWN add volume -2\n",
+                            false, "test");
+    mp_input_enable_section(ictx, "test", 0);
+
+    // Mouse moves the core did not read yet are replaced by the latest one.
+    // The core was woken up for the first one, so the others don't do it.
+    mp_input_set_mouse_pos_artificial(ictx, 10, 20);
+    int first_wakeups = wakeups;
+    assert_true(first_wakeups > 0);
+    mp_input_set_mouse_pos_artificial(ictx, 30, 40);
+    mp_input_set_mouse_pos_artificial(ictx, 50, 60);
+    assert_int_equal(wakeups, first_wakeups);
+    struct mp_cmd *cmd = mp_input_read_cmd(ictx);
+    assert_true(cmd && cmd->mouse_move);
+    assert_int_equal(cmd->mouse_x, 50);
+    assert_int_equal(cmd->mouse_y, 60);
+    talloc_free(cmd);
+    assert_true(!mp_input_read_cmd(ictx));
+
+    // Wheel events for the same binding are summed up.
+    mp_input_put_wheel(ictx, MP_WHEEL_UP, 1.0);
+    first_wakeups = wakeups;
+    mp_input_put_wheel(ictx, MP_WHEEL_UP, 0.5);
+    mp_input_put_wheel(ictx, MP_WHEEL_UP, 1.0);
+    assert_int_equal(wakeups, first_wakeups);
+    cmd = mp_input_read_cmd(ictx);
+    assert_true(cmd);
+    assert_string_equal(cmd->original, "add volume 2");
+    assert_float_equal(cmd->scale, 2.5, 1e-9);
+    talloc_free(cmd);
+    assert_true(!mp_input_read_cmd(ictx));
+
+    // A different binding in between is not merged across.
+    mp_input_put_wheel(ictx, MP_WHEEL_UP, 1.0);
+    mp_input_put_wheel(ictx, MP_WHEEL_DOWN, 1.0);
+    mp_input_put_wheel(ictx, MP_WHEEL_UP, 1.0);
+    for (int n = 0; n < 3; n++) {
+        cmd = mp_input_read_cmd(ictx);
+        assert_true(cmd);
+        assert_float_equal(cmd->scale, 1.0, 1e-9);
+        talloc_free(cmd);
+    }
+    assert_true(!mp_input_read_cmd(ictx));
+
+    mp_input_uninit(ictx);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    test_lookup(ctx);
+    test_coalesce(ctx);
+}
+
+const struct unittest test_input = {
+    .name = "input",
+    .run = run,
+};
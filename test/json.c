@@ -66,6 +66,50 @@ static const struct entry entries[] = {
 
 #define MAX_DEPTH 10
 
+struct limited_out {
+    size_t written;
+    size_t limit;
+    int calls_after_error;
+    bool failed;
+};
+
+static int limited_write(void *ctx, const char *data, size_t len)
+{
+    struct limited_out *out = ctx;
+    if (out->failed)
+        out->calls_after_error++;
+    if (out->written + len > out->limit) {
+        out->failed = true;
+        return -1;
+    }
+    out->written += len;
+    return 0;
+}
+
+// Serialization stops at the first failed write, so callers can bound the
+// memory used for output.
+static void test_write_cb_limit(void)
+{
+    struct mpv_node list[10000];
+    for (int n = 0; n < MP_ARRAY_SIZE(list); n++)
+        list[n] = (struct mpv_node)NODE_STR("some playlist entry.mkv");
+    struct mpv_node src = {
+        .format = MPV_FORMAT_NODE_ARRAY,
+        .u.list = &(struct mpv_node_list){ .num = MP_ARRAY_SIZE(list),
+                                           .values = list },
+    };
+
+    struct limited_out out = { .limit = SIZE_MAX };
+    assert_true(json_write_cb(&src, limited_write, &out) >= 0);
+    size_t full = out.written;
+
+    out = (struct limited_out){ .limit = 16 * 1024 };
+    assert_true(json_write_cb(&src, limited_write, &out) < 0);
+    assert_true(out.failed);
+    assert_int_equal(out.calls_after_error, 0);
+    assert_true(out.written <= out.limit && out.written < full);
+}
+
 static void run(struct test_ctx *ctx)
 {
     for (int n = 0; n < MP_ARRAY_SIZE(entries); n++) {
@@ -86,6 +130,8 @@ static void run(struct test_ctx *ctx)
         assert_true(equal_mpv_node(&e->out_data, &res));
         talloc_free(tmp);
     }
+
+    test_write_cb_limit();
 }
 
 const struct unittest test_json = {
@@ -0,0 +1,90 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include "common/common.h"
+#include "misc/thread_tools.h"
+#include "tests.h"
+
+#define NUM_PRODUCERS 4
+#define NUM_ITEMS 200000
+
+struct item {
+    int producer;
+    int seq;
+};
+
+struct producer {
+    struct mp_mpsc_queue *q;
+    int id;
+};
+
+static void *producer_thread(void *p)
+{
+    struct producer *pr = p;
+    for (int n = 0; n < NUM_ITEMS; n++) {
+        struct item it = {pr->id, n};
+        while (!mp_mpsc_queue_push(pr->q, &it))
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void test_single(void)
+{
+    struct mp_mpsc_queue *q = mp_mpsc_queue_create(NULL, sizeof(int), 3);
+    assert_true(!mp_mpsc_queue_peek(q));
+    // Capacity is rounded up to a power of 2.
+    for (int n = 0; n < 4; n++)
+        assert_true(mp_mpsc_queue_push(q, &n));
+    assert_false(mp_mpsc_queue_push(q, &(int){4}));
+    for (int n = 0; n < 4; n++) {
+        int *p = mp_mpsc_queue_peek(q);
+        assert_true(p);
+        assert_int_equal(*p, n);
+        int v = -1;
+        assert_true(mp_mpsc_queue_pop(q, &v));
+        assert_int_equal(v, n);
+    }
+    assert_false(mp_mpsc_queue_pop(q, NULL));
+    talloc_free(q);
+}
+
+static void test_threads(void)
+{
+    struct mp_mpsc_queue *q = mp_mpsc_queue_create(NULL, sizeof(struct item), 64);
+    struct producer pr[NUM_PRODUCERS];
+    pthread_t threads[NUM_PRODUCERS];
+    int next[NUM_PRODUCERS] = {0};
+    for (int n = 0; n < NUM_PRODUCERS; n++) {
+        pr[n] = (struct producer){q, n};
+        if (pthread_create(&threads[n], NULL, producer_thread, &pr[n]))
+            abort();
+    }
+    // Items from each producer must arrive complete and in order.
+    for (int total = 0; total < NUM_PRODUCERS * NUM_ITEMS;) {
+        struct item it;
+        if (!mp_mpsc_queue_pop(q, &it)) {
+            sched_yield();
+            continue;
+        }
+        assert_true(it.producer >= 0 && it.producer < NUM_PRODUCERS);
+        assert_int_equal(it.seq, next[it.producer]);
+        next[it.producer]++;
+        total++;
+    }
+    for (int n = 0; n < NUM_PRODUCERS; n++)
+        pthread_join(threads[n], NULL);
+    assert_false(mp_mpsc_queue_pop(q, NULL));
+    talloc_free(q);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    test_single();
+    test_threads();
+}
+
+const struct unittest test_mpsc_queue = {
+    .name = "mpsc_queue",
+    .run = run,
+};
@@ -0,0 +1,107 @@
+#include "common/common.h"
+#include "misc/json.h"
+#include "misc/msgpack.h"
+#include "misc/node.h"
+#include "tests.h"
+
+struct entry {
+    const char *src;    // JSON source of the test value
+    const char *packed; // expected encoding (hex), or NULL to skip the check
+};
+
+static const struct entry entries[] = {
+    { "null", "c0" },
+    { "true", "c3" },
+    { "false", "c2" },
+    { "0", "00" },
+    { "127", "7f" },
+    { "128", "d1 00 80" },
+    { "-32", "e0" },
+    { "-33", "d0 df" },
+    { "70000", "d2 00 01 11 70" },
+    { "-5000000000", "d3 ff ff ff fe d5 fa 0e 00" },
+    { "1.5", "cb 3f f8 00 00 00 00 00 00" },
+    { "\"abc\"", "a3 61 62 63" },
+    { "\"\"", "a0" },
+    { "[1,2,3]", "93 01 02 03" },
+    { "[]", "90" },
+    { "{\"a\":1,\"b\":[true]}", "82 a1 61 01 a1 62 91 c3" },
+    { "\"0123456789012345678901234567890123456789\"", NULL },
+    { "[[[[[[1]]]]]]", NULL },
+};
+
+// Invalid input: truncated data, non-string map keys, ext types,
+// uint64 > INT64_MAX, bogus container size.
+static const char *const invalid[] = {
+    "", "a3 61 62", "81 01 01", "d4 00 00", "cf ff ff ff ff ff ff ff ff",
+    "dd ff ff ff ff",
+};
+
+static bstr parse_hex(void *ta_parent, const char *hex)
+{
+    bstr res = {0};
+    while (*hex) {
+        if (*hex == ' ') {
+            hex++;
+            continue;
+        }
+        unsigned int v;
+        sscanf(hex, "%2x", &v);
+        uint8_t c = v;
+        bstr_xappend(ta_parent, &res, (bstr){&c, 1});
+        hex += 2;
+    }
+    return res;
+}
+
+static struct mpv_node parse_json(void *ta_parent, const char *src)
+{
+    char *s = talloc_strdup(ta_parent, src);
+    struct mpv_node res;
+    assert_true(json_parse(ta_parent, &res, &s, 50) >= 0);
+    return res;
+}
+
+static void run(struct test_ctx *ctx)
+{
+    for (int n = 0; n < MP_ARRAY_SIZE(entries); n++) {
+        const struct entry *e = &entries[n];
+        void *tmp = talloc_new(NULL);
+        struct mpv_node src = parse_json(tmp, e->src);
+
+        bstr packed = {0};
+        assert_true(msgpack_write(tmp, &packed, &src) >= 0);
+        if (e->packed) {
+            bstr ref = parse_hex(tmp, e->packed);
+            assert_int_equal(packed.len, ref.len);
+            assert_memcmp(packed.start, ref.start, ref.len);
+        }
+
+        struct mpv_node res;
+        bstr rest = packed;
+        assert_true(msgpack_parse(tmp, &res, &rest, 50) >= 0);
+        assert_int_equal(rest.len, 0);
+        assert_true(equal_mpv_node(&src, &res));
+        talloc_free(tmp);
+    }
+
+    for (int n = 0; n < MP_ARRAY_SIZE(invalid); n++) {
+        void *tmp = talloc_new(NULL);
+        bstr data = parse_hex(tmp, invalid[n]);
+        struct mpv_node res;
+        assert_true(msgpack_parse(tmp, &res, &data, 50) < 0);
+        talloc_free(tmp);
+    }
+
+    // Depth limit.
+    void *tmp = talloc_new(NULL);
+    bstr deep = parse_hex(tmp, "91 91 91 01");
+    struct mpv_node res;
+    assert_true(msgpack_parse(tmp, &res, &deep, 2) < 0);
+    talloc_free(tmp);
+}
+
+const struct unittest test_msgpack = {
+    .name = "msgpack",
+    .run = run,
+};
@@ -0,0 +1,102 @@
+#include "common/common.h"
+#include "misc/json.h"
+#include "misc/node.h"
+#include "tests.h"
+
+static int destroyed;
+
+static void count_destroy(void *p)
+{
+    destroyed++;
+}
+
+static void test_basics(void)
+{
+    char *root = talloc_zero_arena_size(NULL, 8);
+    assert_int_equal(talloc_get_size(root), 8);
+
+    int *a = talloc_zero_array(root, int, 10);
+    for (int n = 0; n < 10; n++)
+        assert_int_equal(a[n], 0);
+    assert_int_equal(talloc_get_size(a), 10 * sizeof(int));
+
+    // Children of arena members come from the same arena.
+    char *s = talloc_strdup(a, "hello");
+    assert_string_equal(s, "hello");
+    talloc_set_destructor(s, count_destroy);
+
+    // Growing the most recent allocation, and growing an older one.
+    s = talloc_strdup_append(s, " world");
+    assert_string_equal(s, "hello world");
+    a = talloc_realloc(root, a, int, 1000);
+    a[999] = 123;
+    assert_int_equal(talloc_get_size(a), 1000 * sizeof(int));
+    assert_string_equal(s, "hello world");
+
+    // Moving within the arena is allowed.
+    talloc_steal(root, s);
+    talloc_free(a);
+    assert_string_equal(s, "hello world");
+
+    // Normal allocations can be moved into the arena.
+    char *normal = talloc_strdup(NULL, "normal");
+    talloc_set_destructor(normal, count_destroy);
+    talloc_steal(s, normal);
+
+    // The root can be reallocated and moved.
+    void *parent = talloc_new(NULL);
+    root = talloc_realloc_size(NULL, root, 100000);
+    talloc_steal(parent, root);
+    s = talloc_strdup_append(s, "!");
+    assert_string_equal(s, "hello world!");
+
+    destroyed = 0;
+    talloc_free(parent);
+    assert_int_equal(destroyed, 2);
+}
+
+static void test_free_reuse(void)
+{
+    void *root = talloc_new_arena(NULL);
+    for (int n = 0; n < 100000; n++) {
+        // Freeing the most recent allocation gives the memory back.
+        char *tmp = talloc_size(root, 1000);
+        memset(tmp, n & 0xFF, 1000);
+        talloc_free(tmp);
+    }
+    talloc_free_children(root);
+    void *big = talloc_zero_size(root, 1 << 20);
+    assert_int_equal(((char *)big)[(1 << 20) - 1], 0);
+    talloc_free(root);
+}
+
+static void test_json_tree(void)
+{
+    const char *src = "{\"command\": [\"get_property\", \"playback-time\"], "
+                      "\"request_id\": 12, \"async\": false}";
+    void *root = talloc_new_arena(NULL);
+    char *text = talloc_strdup(root, src);
+    struct mpv_node node;
+    int r = json_parse(root, &node, &text, 50);
+    assert_true(r >= 0);
+    node_map_add_string(&node, "error", "success");
+    char *dst = talloc_strdup(root, "");
+    r = json_write(&dst, &node);
+    assert_true(r >= 0);
+    assert_string_equal(dst, "{\"command\":[\"get_property\",\"playback-time\"],"
+                             "\"request_id\":12,\"async\":false,"
+                             "\"error\":\"success\"}");
+    talloc_free(root);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    test_basics();
+    test_free_reuse();
+    test_json_tree();
+}
+
+const struct unittest test_ta_arena = {
+    .name = "ta_arena",
+    .run = run,
+};
@@ -4,13 +4,19 @@
 #include "tests.h"
 
 static const struct unittest *unittests[] = {
+    &test_aframe,
     &test_chmap,
+    &test_config_cache,
     &test_gl_video,
     &test_img_format,
+    &test_input,
     &test_json,
     &test_linked_list,
+    &test_mpsc_queue,
+    &test_msgpack,
     &test_paths,
     &test_repack_sws,
+    &test_ta_arena,
 #if HAVE_ZIMG
     &test_repack, // zimg only due to cross-checking with zimg.c
     &test_repack_zimg,
@@ -36,15 +36,21 @@ struct unittest {
     void (*run)(struct test_ctx *ctx);
 };
 
+extern const struct unittest test_aframe;
 extern const struct unittest test_chmap;
+extern const struct unittest test_config_cache;
 extern const struct unittest test_gl_video;
 extern const struct unittest test_img_format;
+extern const struct unittest test_input;
 extern const struct unittest test_json;
 extern const struct unittest test_linked_list;
+extern const struct unittest test_mpsc_queue;
+extern const struct unittest test_msgpack;
 extern const struct unittest test_repack_sws;
 extern const struct unittest test_repack_zimg;
 extern const struct unittest test_repack;
 extern const struct unittest test_paths;
+extern const struct unittest test_ta_arena;
 
 #define assert_true(x) assert(x)
 #define assert_false(x) assert(!(x))
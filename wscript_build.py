@@ -323,6 +323,7 @@ def build(ctx):
         ( "misc/dispatch.c" ),
         ( "misc/jni.c",                          "android" ),
         ( "misc/json.c" ),
+        ( "misc/msgpack.c" ),
         ( "misc/natural_sort.c" ),
         ( "misc/node.c" ),
         ( "misc/rendezvous.c" ),
@@ -393,16 +394,22 @@ def build(ctx):
         ( "sub/sd_lavc.c" ),
 
         ## Tests
+        ( "test/aframe.c",                       "tests" ),
         ( "test/chmap.c",                        "tests" ),
+        ( "test/config_cache.c",                 "tests" ),
         ( "test/gl_video.c",                     "tests" ),
         ( "test/img_format.c",                   "tests" ),
+        ( "test/input.c",                        "tests" ),
         ( "test/json.c",                         "tests" ),
         ( "test/linked_list.c",                  "tests" ),
+        ( "test/mpsc_queue.c",                   "tests" ),
+        ( "test/msgpack.c",                      "tests" ),
         ( "test/paths.c",                        "tests" ),
         ( "test/repack.c",                       "tests && zimg" ),
         ( "test/scale_sws.c",                    "tests" ),
         ( "test/scale_test.c",                   "tests" ),
         ( "test/scale_zimg.c",                   "tests && zimg" ),
+        ( "test/ta_arena.c",                     "tests" ),
         ( "test/tests.c",                        "tests" ),
 
         ## Video